@@ -0,0 +1,251 @@
+/*
+
+Defines class address_trace, which records the addresses that the
+dereferences of iteration_counter touch, and class cache_hierarchy, a
+model of a multi-level set-associative cache that a trace is replayed
+through to count the misses at each level.  The modeled misses depend
+only on the algorithm and its input, not on the machine or on what
+else it is doing, so they are reproducible where hardware counters
+(perfcount.h) are noisy or unavailable.
+
+A trace is recorded by the calling thread while an address_trace_scope
+for it is alive, from the dereferences of the iteration_counters that
+have Traced set, as those of counting<Container, traced_counting> do;
+the other iteration_counters have no hook at all.  The trace keeps
+cache lines, not addresses, each as the 32-bit difference from the
+line before, and folds repeated accesses to the same line into a
+count, which is exact for LRU caches: the line is the most recently
+used in the first level, so the repeats can only hit there.  Only the
+elements of the sequence are traced, not the values the algorithms
+keep in variables or in scratch buffers.
+
+Each level of the model has a size, an associativity and least
+recently used replacement; all levels share the line size of the
+trace.  A line that misses in a level is brought into it, and into
+every level below it that it also misses, which models non-inclusive
+caches; default_cache_levels describes a typical desktop processor.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sys/types.h>
+
+const unsigned cache_line_bytes = 64;
+
+/* One level of a cache_hierarchy. */
+struct cache_level {
+  const char* name;
+  size_t bytes;
+  unsigned ways;
+};
+
+static const std::vector<cache_level> default_cache_levels =
+  {{"L1", size_t(32) << 10, 8},
+   {"L2", size_t(1) << 20, 16},
+   {"L3", size_t(8) << 20, 16}};
+
+class address_trace {
+protected:
+  enum : int32_t { escape = INT32_MIN };
+
+  std::vector<int32_t> deltas;
+  uint64_t last_line;
+  ssize_t repeats;
+
+public:
+  address_trace() : last_line(0), repeats(0) {}
+
+  void
+  record(
+    const void* address
+  ){
+    uint64_t line = uint64_t(uintptr_t(address)) / cache_line_bytes;
+    if (!deltas.empty() && line == last_line) {
+      ++repeats;
+      return;
+    }
+    int64_t delta = int64_t(line - last_line);
+    if (delta > escape && delta <= INT32_MAX) {
+      deltas.push_back(int32_t(delta));
+    } else {
+      deltas.push_back(escape);
+      deltas.push_back(int32_t(line >> 32));
+      deltas.push_back(int32_t(line & 0xffffffff));
+    }
+    last_line = line;
+  }
+
+  /* The number of accesses recorded. */
+  ssize_t
+  size(
+  ) const {
+    return ssize_t(deltas.size()) + repeats;
+  }
+
+  /* The number of accesses that went to the same line as the one
+     before. */
+  ssize_t
+  repeated(
+  ) const {
+    return repeats;
+  }
+
+  void
+  clear(
+  ){
+    std::vector<int32_t>().swap(deltas);
+    last_line = 0;
+    repeats = 0;
+  }
+
+  /* Calls visit with each line that was accessed after a different
+     one, in order. */
+  template <
+    typename Visitor>
+  void
+  replay(
+    Visitor visit
+  ) const {
+    uint64_t line = 0;
+    for (size_t i = 0; i < deltas.size(); ++i) {
+      if (deltas[i] == escape) {
+        line = uint64_t(uint32_t(deltas[i + 1])) << 32 | uint32_t(deltas[i + 2]);
+        i += 2;
+      } else {
+        line += int64_t(deltas[i]);
+      }
+      visit(line);
+    }
+  }
+
+  /* The trace that the calling thread records into, if any. */
+  static
+  address_trace*&
+  current(
+  ){
+    static thread_local address_trace* trace = nullptr;
+    return trace;
+  }
+};
+
+inline
+void
+trace_dereference(
+  const void* address
+){
+  if (address_trace* trace = address_trace::current())
+    trace->record(address);
+}
+
+/* Records the dereferences of the calling thread into trace for as
+   long as it is alive. */
+class address_trace_scope {
+protected:
+  address_trace* previous;
+
+public:
+  explicit
+  address_trace_scope(
+    address_trace& trace
+  ) : previous(address_trace::current()) {
+    address_trace::current() = &trace;
+  }
+
+  address_trace_scope(const address_trace_scope&) = delete;
+
+  ~address_trace_scope(
+  ){
+    address_trace::current() = previous;
+  }
+};
+
+/* A set-associative cache with least recently used replacement. */
+class set_associative_cache {
+protected:
+  size_t sets;
+  unsigned ways;
+  std::vector<uint64_t> tags;
+  std::vector<uint64_t> stamps;
+  uint64_t clock;
+
+public:
+  explicit
+  set_associative_cache(
+    const cache_level& level
+  ) : sets(level.bytes / cache_line_bytes / level.ways), ways(level.ways),
+      tags(sets * ways, ~uint64_t(0)), stamps(sets * ways, 0), clock(0) {}
+
+  /* Accesses line and returns whether it hit. */
+  bool
+  access(
+    uint64_t line
+  ){
+    size_t first = (line % sets) * ways;
+    size_t victim = first;
+    ++clock;
+    for (size_t w = first; w < first + ways; ++w) {
+      if (tags[w] == line) {
+        stamps[w] = clock;
+        return true;
+      }
+      if (stamps[w] < stamps[victim])
+        victim = w;
+    }
+    tags[victim] = line;
+    stamps[victim] = clock;
+    return false;
+  }
+};
+
+class cache_hierarchy {
+protected:
+  std::vector<cache_level> configuration;
+  std::vector<set_associative_cache> levels;
+  std::vector<ssize_t> level_misses;
+
+public:
+  explicit
+  cache_hierarchy(
+    const std::vector<cache_level>& configuration = default_cache_levels
+  ) : configuration(configuration), level_misses(configuration.size(), 0) {
+    for (const cache_level& level : configuration)
+      levels.push_back(set_associative_cache(level));
+  }
+
+  const std::vector<cache_level>&
+  configured_levels(
+  ) const {
+    return configuration;
+  }
+
+  void
+  access(
+    uint64_t line
+  ){
+    for (size_t l = 0; l < levels.size(); ++l) {
+      if (levels[l].access(line))
+        return;
+      ++level_misses[l];
+    }
+  }
+
+  /* Replays trace, starting from the current contents of the caches. */
+  void
+  replay(
+    const address_trace& trace
+  ){
+    trace.replay([this](uint64_t line) { access(line); });
+  }
+
+  /* The misses at each level since construction. */
+  const std::vector<ssize_t>&
+  misses(
+  ) const {
+    return level_misses;
+  }
+};
@@ -0,0 +1,121 @@
+/*
+
+Defines the phases that the costs of introsort are attributed to, and
+cost_phase_scope, which intsort.h puts around each of them: the
+partitioning of introsort_loop and its variants, the heapsort they fall
+back on when the depth limit runs out, and the final insertion sort.
+Everything outside a scope, such as copying the input, is other_phase.
+
+While a scope is alive, the calling thread counts into the shards of
+its phase (see shardcount.h), so every count of counter,
+iteration_counter and distance_counter can be read for each phase with
+sharded_count::in_phase.  Between start_cost_phase_timing and
+stop_cost_phase_timing, the thread also adds the time it spends in
+each phase to cost_phase_nanoseconds, reading the clock only when the
+phase changes.  The scopes are nested, and time and counts go to the
+innermost one, so the heapsort a partitioning step falls back on is
+not counted as partitioning.  Without timing, entering and leaving a
+scope costs two stores to thread-local variables.
+
+*/
+
+#pragma once
+
+#include <chrono>
+
+#include "shardcount.h"
+
+enum cost_phase {
+  other_phase,
+  partition_phase,
+  heapsort_phase,
+  insertion_phase,
+  cost_phase_count
+};
+
+static_assert(cost_phase_count <= count_phase_capacity,
+              "every phase needs its own count shards");
+
+static const char* const cost_phase_names[cost_phase_count] =
+  {"other",
+   "partitioning",
+   "heapsort",
+   "insertion sort"};
+
+/* The time spent in each phase while phase timing was on, read with
+   in_phase. */
+inline sharded_count cost_phase_nanoseconds;
+
+struct cost_phase_clock {
+  bool timing;
+  std::chrono::steady_clock::time_point since;
+};
+
+inline
+cost_phase_clock&
+local_cost_phase_clock(
+){
+  static thread_local cost_phase_clock clock = {false, {}};
+  return clock;
+}
+
+/* Charges the time since the last change to the current phase. */
+inline
+void
+charge_cost_phase_time(
+  cost_phase_clock& clock
+){
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  cost_phase_nanoseconds +=
+    std::chrono::duration_cast<std::chrono::nanoseconds>(now - clock.since).count();
+  clock.since = now;
+}
+
+inline
+void
+start_cost_phase_timing(
+){
+  cost_phase_clock& clock = local_cost_phase_clock();
+  clock.timing = true;
+  clock.since = std::chrono::steady_clock::now();
+}
+
+inline
+void
+stop_cost_phase_timing(
+){
+  cost_phase_clock& clock = local_cost_phase_clock();
+  charge_cost_phase_time(clock);
+  clock.timing = false;
+}
+
+/* Makes phase the current one of the calling thread and returns the
+   one before. */
+inline
+int
+switch_cost_phase(
+  int phase
+){
+  cost_phase_clock& clock = local_cost_phase_clock();
+  if (clock.timing)
+    charge_cost_phase_time(clock);
+  return set_count_phase(phase);
+}
+
+class cost_phase_scope {
+protected:
+  int previous;
+
+public:
+  explicit
+  cost_phase_scope(
+    cost_phase phase
+  ) : previous(switch_cost_phase(phase)) {}
+
+  cost_phase_scope(const cost_phase_scope&) = delete;
+
+  ~cost_phase_scope(
+  ){
+    switch_cost_phase(previous);
+  }
+};
@@ -25,6 +25,8 @@ operations, using values of type ssize_t.
 
 #include <iostream>
 
+#include "shardcount.h"
+
 using std::endl;
 using std::ostream;
 
@@ -33,9 +35,9 @@ class counter {
 protected:
   T value;
 public:
-  static ssize_t assignments;
-  static ssize_t comparisons;
-  static ssize_t accesses;
+  static sharded_count assignments;
+  static sharded_count comparisons;
+  static sharded_count accesses;
 
   T base() const {++accesses; return value;}
 
@@ -48,6 +50,10 @@ public:
   static ssize_t total() {
     return assignments + comparisons + accesses; }
 
+  static ssize_t total(int phase) {
+    return assignments.in_phase(phase) + comparisons.in_phase(phase)
+           + accesses.in_phase(phase); }
+
   static void reset() {
     assignments = 0;
     comparisons = 0;
@@ -93,10 +99,10 @@ public:
 };
 
 template <class T>
-ssize_t counter<T>::assignments = 0;
+sharded_count counter<T>::assignments;
 
 template <class T>
-ssize_t counter<T>::comparisons = 0;
+sharded_count counter<T>::comparisons;
 
 template <class T>
-ssize_t counter<T>::accesses = 0;
+sharded_count counter<T>::accesses;
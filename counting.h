@@ -8,26 +8,69 @@
 #include "distcount.h"
 #include "itercount.h"
 #include "intsort.h"
+#include "samplesort.h"
+#include "stablesort.h"
 
 const int number_of_trials = 7;
 
 static std::vector<std::string> headings =
   {" Introsort",
-   " Heapsort"};
+   " Heapsort",
+   " Introsort (block partition)",
+   " Samplesort",
+   " Introsort (ninther)",
+   " Introsort (sampled pivot)",
+   " Introsort (adaptive pivot)",
+   " Bottom-up heapsort",
+   " 4-ary heapsort",
+   " 8-ary heapsort",
+   " Introsort (three-way)",
+   " Introsort (pattern-defeating)",
+   " Introsort (iterative)",
+   " Introsort (dual-pivot)",
+   " Introsort (three-pivot)",
+   " Stable merge sort"};
 
-template <class Container>
+/* Counting policies for class counting: full_counting wraps the
+   iterators and distances of the container in iteration_counter and
+   distance_counter, traced_counting does the same with iterators that
+   also feed the address_trace of the thread (see cachesim.h), and
+   no_counting uses them as they are, so that the algorithms compile to
+   what they would be without counting. */
+template <bool Traced = false>
+struct counting_policy {
+  template <class Container>
+  struct types {
+    typedef distance_counter<
+      typename Container::iterator,
+      typename Container::difference_type> distance;
+
+    typedef iteration_counter<
+      typename Container::iterator,
+      typename Container::value_type,
+      typename Container::value_type&,
+      distance,
+      Traced> iterator;
+  };
+};
+
+typedef counting_policy<false> full_counting;
+typedef counting_policy<true> traced_counting;
+
+struct no_counting {
+  template <class Container>
+  struct types {
+    typedef typename Container::difference_type distance;
+    typedef typename Container::iterator iterator;
+  };
+};
+
+template <class Container, class Counting = full_counting>
 class counting {
 public:
 
-  typedef distance_counter<
-    typename Container::iterator,
-    typename Container::difference_type> distance;
-
-  typedef iteration_counter<
-    typename Container::iterator,
-    typename Container::value_type,
-    typename Container::value_type&,
-    distance> iterator;
+  typedef typename Counting::template types<Container>::distance distance;
+  typedef typename Counting::template types<Container>::iterator iterator;
 
   static void algorithm(int k, Container& x)
   {
@@ -37,8 +80,71 @@ public:
                          iterator(x.end()));
     break;//*
     case 0: introsort(iterator(x.begin()),
-                      iterator(x.end()));
+                      iterator(x.end()),
+                      __gnu_cxx::__ops::__iter_less_iter());
       break;//*/
+    case 2: introsort(iterator(x.begin()),
+                      iterator(x.end()),
+                      __gnu_cxx::__ops::__iter_less_iter(),
+                      block_partition());
+      break;
+    case 3: samplesort(iterator(x.begin()),
+                       iterator(x.end()));
+      break;
+    case 4: introsort(iterator(x.begin()),
+                      iterator(x.end()),
+                      __gnu_cxx::__ops::__iter_less_iter(),
+                      hoare_partition(),
+                      ninther_pivot());
+      break;
+    case 5: introsort(iterator(x.begin()),
+                      iterator(x.end()),
+                      __gnu_cxx::__ops::__iter_less_iter(),
+                      hoare_partition(),
+                      sampled_pivot());
+      break;
+    case 6: introsort(iterator(x.begin()),
+                      iterator(x.end()),
+                      __gnu_cxx::__ops::__iter_less_iter(),
+                      hoare_partition(),
+                      adaptive_pivot());
+      break;
+    case 7: bottom_up_heapsort(iterator(x.begin()),
+                               iterator(x.end()),
+                               __gnu_cxx::__ops::__iter_less_iter());
+      break;
+    case 8: dary_heapsort<4>(iterator(x.begin()),
+                             iterator(x.end()),
+                             __gnu_cxx::__ops::__iter_less_iter());
+      break;
+    case 9: dary_heapsort<8>(iterator(x.begin()),
+                             iterator(x.end()),
+                             __gnu_cxx::__ops::__iter_less_iter());
+      break;
+    case 10: three_way_introsort(iterator(x.begin()),
+                                 iterator(x.end()),
+                                 __gnu_cxx::__ops::__iter_less_iter());
+      break;
+    case 11: adaptive_introsort(iterator(x.begin()),
+                                iterator(x.end()),
+                                __gnu_cxx::__ops::__iter_less_iter());
+      break;
+    case 12: iterative_introsort(iterator(x.begin()),
+                                 iterator(x.end()),
+                                 __gnu_cxx::__ops::__iter_less_iter());
+      break;
+    case 13: dual_pivot_introsort(iterator(x.begin()),
+                                  iterator(x.end()),
+                                  __gnu_cxx::__ops::__iter_less_iter());
+      break;
+    case 14: three_pivot_introsort(iterator(x.begin()),
+                                   iterator(x.end()),
+                                   __gnu_cxx::__ops::__iter_less_iter());
+      break;
+    case 15: stable_merge_sort(iterator(x.begin()),
+                               iterator(x.end()),
+                               __gnu_cxx::__ops::__iter_less_iter());
+      break;
     /*case 0: std::sort(iterator(x.begin()),
                       iterator(x.end()));
       break;//*/
@@ -30,6 +30,8 @@ is its distance type.
 #include <iostream>
 #include <utility>
 
+#include "shardcount.h"
+
 using std::endl;
 using std::ostream;
 using std::pair;
@@ -151,17 +153,17 @@ protected:
     Distance current;
     ssize_t generation;
 public:
-    static ssize_t constructions;
-    static ssize_t copy_constructions;
-    static ssize_t conversions;
-    static ssize_t assignments;
-    static ssize_t increments;
-    static ssize_t additions;
-    static ssize_t subtractions;
-    static ssize_t multiplications;
-    static ssize_t divisions;
-    static ssize_t comparisons;
-    static ssize_t max_generation;
+    static sharded_count constructions;
+    static sharded_count copy_constructions;
+    static sharded_count conversions;
+    static sharded_count assignments;
+    static sharded_count increments;
+    static sharded_count additions;
+    static sharded_count subtractions;
+    static sharded_count multiplications;
+    static sharded_count divisions;
+    static sharded_count comparisons;
+    static sharded_max max_generation;
 
     static void reset() {
       constructions = 0;
@@ -185,6 +187,15 @@ public:
               + comparisons;
     }
 
+    static ssize_t total(int phase) {
+      return constructions.in_phase(phase) + copy_constructions.in_phase(phase)
+              + conversions.in_phase(phase)
+              + assignments.in_phase(phase) + increments.in_phase(phase)
+              + additions.in_phase(phase) + subtractions.in_phase(phase)
+              + multiplications.in_phase(phase) + divisions.in_phase(phase)
+              + comparisons.in_phase(phase);
+    }
+
     static void report(ostream& o) {
       o << "Distance stats: \n"
         << "  Constructions:   " << constructions << "\n"
@@ -220,9 +231,7 @@ public:
       current = c.current;
       generation = c.generation + 1;
       ++copy_constructions;
-      if (generation > max_generation) {
-        max_generation = generation;
-      }
+      max_generation.raise(generation);
     }
 
     Distance base() const
@@ -548,47 +557,47 @@ operator*(
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::constructions = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::constructions;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::copy_constructions = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::copy_constructions;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::conversions = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::conversions;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::assignments = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::assignments;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::increments = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::increments;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::additions = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::additions;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::subtractions = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::subtractions;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::multiplications = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::multiplications;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::divisions = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::divisions;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::comparisons = 0;
+sharded_count distance_counter<RandomAccessIterator, Distance>::comparisons;
 template <
   typename RandomAccessIterator,
   typename Distance>
-ssize_t distance_counter<RandomAccessIterator, Distance>::max_generation = 0;
+sharded_max distance_counter<RandomAccessIterator, Distance>::max_generation;
 
 /* The purpose of the following version of get_temporarary_buffer is to
    enable the STL stable_sort generic algorithms to work with
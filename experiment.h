@@ -10,6 +10,66 @@ algorithms, and algorithm, which selects one of several algorithms for
 measurement.  See tsort3.cpp for an example definition of the counting
 class.
 
+Member function run measures every algorithm twice on the same input:
+once with the no_counting policy on a sequence of type Container<I>,
+for the Time column, and once with full_counting on a sequence of
+counters, for the operation counts and the Counted time column, so
+that the time is not inflated by the counting.  The processor events
+of the uninstrumented run are counted with hardware_counters and
+reported after the operation counts, where perf_event_open allows.
+A second table breaks the time and the operations of each algorithm
+down by the phases of costphase.h: partitioning, the heapsort
+fallback, the final insertion sort, and everything else.  The phase
+times come from a third run, uninstrumented like the first but with
+phase timing on, so that reading the clock at each change of phase
+slows neither the Time column nor the events.
+Member function cache replays the addresses that the algorithms
+dereference through the cache model of cachesim.h instead, and
+reports the modeled misses per element at each level.
+
+Member function contrast carries out a second kind of experiment: it
+sorts uninstrumented sequences of type Container<I> with two sorting
+functions and reports their elapsed times and the speedup of the
+second over the first.  These member functions use it:
+
+  - speedup compares the serial introsort with the parallel introsort
+    of parsort.h;
+  - simd compares the scalar introsort with the vectorized one of
+    simdsort.h;
+  - radix compares the comparison introsort with the radix sort of
+    radixsort.h;
+  - parallel_samplesort compares the parallel introsort with the
+    parallel samplesort of samplesort.h;
+  - duplicates compares introsort with three_way_introsort on
+    sequences with few distinct keys;
+  - patterns compares introsort with adaptive_introsort on sorted,
+    reversed and other patterned sequences;
+  - iterative compares the recursive introsort with
+    iterative_introsort.
+
+The other member functions run experiments of their own:
+
+  - thresholds times introsort with a range of insertion sort
+    thresholds and depth limit multipliers, on values of type I and on
+    larger records;
+  - autotune measures the constants of tuning.h and writes the fastest
+    ones to introsort_config.h;
+  - selection compares the selection algorithms of intselect.h with
+    partial_sort and nth_element for a range of k/N;
+  - projection compares sorting by a computed key with a comparator
+    and with projected_introsort;
+  - indirect compares introsort with indirect_introsort on records of
+    several sizes;
+  - segments reports the segments per second that segmented_sort
+    sorts;
+  - incremental compares incremental_sort with sorting again after
+    appending a batch;
+  - multipivot times the dual- and three-pivot introsorts against
+    introsort;
+  - external sorts a binary file of values of type I with the
+    external_sort of extsort.h and reports the throughput of each of
+    its phases.
+
 */
 
 /*
@@ -32,11 +92,22 @@ class.
 #include <iostream>
 #include <iterator>
 #include <random>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "counting.h"
+#include "cachesim.h"
+#include "extsort.h"
+#include "incsort.h"
+#include "intselect.h"
+#include "projsort.h"
 #include "counter.h"
 #include "itercount.h"
+#include "parsort.h"
+#include "perfcount.h"
+#include "samplesort.h"
+#include "segsort.h"
 #include "recorder.h"
 #include "timer.h"
 
@@ -50,6 +121,35 @@ using std::ostream;
 using std::setw;
 using std::vector;
 
+/* A value of Bytes bytes ordered by its key, for timing sorts of large
+   records. */
+template <
+  typename Key,
+  size_t Bytes>
+struct record {
+  Key key;
+  char payload[Bytes - sizeof(Key)];
+
+  record() {}
+  explicit record(Key k) : key(k) {}
+
+  bool operator<(const record& r) const { return key < r.key; }
+  bool operator==(const record& r) const { return key == r.key; }
+};
+
+/* The thresholds and depth multipliers tried by experiment::thresholds. */
+typedef std::integer_sequence<ptrdiff_t, 4, 8, 12, 16, 24, 32, 48, 64> swept_thresholds;
+typedef std::integer_sequence<int, 1, 2, 3, 4> swept_depth_multipliers;
+
+/* Orders of the input sequences of experiment::contrast. */
+enum input_pattern {
+  shuffled_input,
+  sorted_input,
+  reversed_input,
+  nearly_sorted_input,
+  organ_pipe_input
+};
+
 template <typename I, typename D, template <typename> class T, template<typename, typename...> class Container>
 class experiment {
   typedef T<I> value_type;
@@ -82,10 +182,15 @@ public:
     ofstream ofs1("read.dat");
     ofstream ofs2("graph.dat");
 
-    vector<recorder<value_type, iterator, distance> > stats(2);
+    vector<recorder<value_type, iterator, distance> > stats(headings.size());
 
     int repetitions = max(32/N1, 1);
 
+    hardware_counters events;
+    if (!events.any_available())
+      cout << "Hardware counters are unavailable (" << events.reason()
+           << "); their columns are shown as -.\n";
+
     cout << std::endl;
     ofs1 << std::endl;
 
@@ -97,9 +202,10 @@ public:
       ofs1 << "Size: " << setw(4) << N0 << flush;
       ofs2 << setw(4) << N0 << flush;
 
-      Container<value_type> x;
+      Container<I> u;
       for (int i = 0; i < N; ++i)
-        x.push_back(T(i));
+        u.push_back(I(i));
+      Container<value_type> x;
 
       int p, q;
 
@@ -107,14 +213,38 @@ public:
         n->reset();
 
       for (p = 0; p < number_of_trials; ++p) {
-        std::random_shuffle(x.begin(), x.end());
-        Container<value_type> y(x);
+        std::random_shuffle(u.begin(), u.end());
+        Container<I> v(u);
+        Container<value_type> y;
+        for (int i = 0; i < N; ++i)
+          y.push_back(T(v[i]));
         Container<value_type>::value_type::assignments = 0;
 
         cout << p+1 << ":" << flush;
 
         for (size_t n = 0; n < stats.size(); ++n) {
           timer stop_watch = timer();
+          stop_watch.start();
+          events.start();
+          for (q = 0; q < repetitions; ++q) {
+            u = v;
+            counting<Container<I>, no_counting>::algorithm(n, u);
+          }
+          events.stop();
+          stop_watch.stop();
+          double time_taken = stop_watch.lap_time();
+          hardware_counts event_counts = events.counts();
+
+          for (int z = 0; z < N; ++z)
+            assert(u[z] == I(z));
+
+          start_cost_phase_timing();
+          for (q = 0; q < repetitions; ++q) {
+            u = v;
+            counting<Container<I>, no_counting>::algorithm(n, u);
+          }
+          stop_cost_phase_timing();
+
           stop_watch.start();
           for (q = 0; q < repetitions; ++q) {
             x = y;
@@ -122,7 +252,7 @@ public:
             counting<Container<value_type> >::algorithm(n, x);
           }
           stop_watch.stop();
-          stats[n].record(stop_watch.lap_time());
+          stats[n].record(time_taken, stop_watch.lap_time(), event_counts);
 
           for (int z = 0; z < N; ++z)
             assert(x[z] == T(z));
@@ -141,6 +271,7 @@ public:
       cout << endl
         << setw(width) << "Algorithm"
         << setw(width) << "Time"
+        << setw(width) << "Counted time"
         << setw(width) << "data assignments"
         << setw(width) << "data comparisons"
         << setw(width) << "data accesses"
@@ -162,12 +293,15 @@ public:
         << setw(width) << "iterator bigjumps"
         << setw(width) << "iterator comparisons"
         << setw(width) << "iterator max generation"
-        << setw(width) << "total"
-        << endl;
+        << setw(width) << "total";
+      for (int e = 0; e < hardware_event_count; ++e)
+        cout << setw(width) << hardware_event_names[e];
+      cout << endl;
 
       ofs1 << endl
         << setw(width) << "Algorithm"
         << setw(width) << "Time"
+        << setw(width) << "Counted time"
         << setw(width) << "data assignments"
         << setw(width) << "data comparisons"
         << setw(width) << "data accesses"
@@ -189,8 +323,10 @@ public:
         << setw(width) << "iterator bigjumps"
         << setw(width) << "iterator comparisons"
         << setw(width) << "iterator max generation"
-        << setw(width) << "total"
-        << endl;
+        << setw(width) << "total";
+      for (int e = 0; e < hardware_event_count; ++e)
+        ofs1 << setw(width) << hardware_event_names[e];
+      ofs1 << endl;
 
 
 
@@ -202,6 +338,28 @@ public:
         stats[n].report(ofs2, repetitions);
       }
 
+      cout << endl
+        << setw(width) << "Algorithm"
+        << setw(width) << "Phase"
+        << setw(width) << "Time"
+        << setw(width) << "data operations"
+        << setw(width) << "distance operations"
+        << setw(width) << "iterator operations"
+        << endl;
+      ofs1 << endl
+        << setw(width) << "Algorithm"
+        << setw(width) << "Phase"
+        << setw(width) << "Time"
+        << setw(width) << "data operations"
+        << setw(width) << "distance operations"
+        << setw(width) << "iterator operations"
+        << endl;
+
+      for (size_t n = 0; n < stats.size(); ++n) {
+        stats[n].report_phases(cout, headings[n], repetitions);
+        stats[n].report_phases(ofs1, headings[n], repetitions);
+      }
+
       cout << endl;
       ofs1 << endl;
       ofs2 << endl;
@@ -212,4 +370,1152 @@ public:
         repetitions /= 2;
     }
   }
+
+  /*
+  Records the addresses that each algorithm of class counting
+  dereferences while sorting a random permutation, replays them
+  through a cache_hierarchy with the default_cache_levels of
+  cachesim.h, and reports the accesses and the modeled misses at each
+  level per element.  Each algorithm starts with empty caches.
+  */
+  static
+  void
+  cache(
+  ){
+    const int factor = 1000;
+
+    cout << "All sequence sizes are in multiples of " << factor << ".\n";
+    cout << "Input the smallest sequence size: " << flush;
+    int N1;
+    cin >> N1;
+    cout << "Input the largest sequence sizes: " << flush;
+    int N2;
+    cin >> N2;
+
+    ofstream ofs("cache.dat");
+    int width = 14;
+    const std::vector<cache_level>& levels = default_cache_levels;
+
+    cout << endl << "Misses per element, with";
+    for (const cache_level& level : levels)
+      cout << " " << level.name << " " << (level.bytes >> 10) << "K "
+           << level.ways << "-way";
+    cout << " and " << cache_line_bytes << "-byte lines.\n";
+    cout << setiosflags(ios::fixed) << setprecision(3);
+    ofs << setiosflags(ios::fixed) << setprecision(3);
+
+    std::mt19937 generator(1);
+    address_trace trace;
+
+    for (int N0 = N1; N0 <= N2; N0 *= 2) {
+      int N = N0 * factor;
+
+      Container<value_type> y;
+      for (int i = 0; i < N; ++i)
+        y.push_back(T(i));
+      std::shuffle(y.begin(), y.end(), generator);
+
+      cout << endl << "Size: " << setw(4) << N0 << endl
+           << setw(30) << "Algorithm" << setw(width) << "Accesses";
+      for (const cache_level& level : levels)
+        cout << setw(width) << level.name;
+      cout << endl;
+
+      for (size_t n = 0; n < headings.size(); ++n) {
+        Container<value_type> x(y);
+        {
+          address_trace_scope scope(trace);
+          counting<Container<value_type>, traced_counting>::algorithm(n, x);
+        }
+        for (int z = 0; z < N; ++z)
+          assert(x[z] == T(z));
+
+        cache_hierarchy caches(levels);
+        caches.replay(trace);
+
+        cout << setw(30) << headings[n] << setw(width) << double(trace.size()) / N;
+        ofs << setw(6) << N0 << setw(4) << n << setw(width) << double(trace.size()) / N;
+        for (ssize_t misses : caches.misses()) {
+          cout << setw(width) << double(misses) / N;
+          ofs << setw(width) << double(misses) / N;
+        }
+        cout << endl;
+        ofs << endl;
+        trace.clear();
+      }
+    }
+  }
+
+  /*
+  Rearranges the shuffled sequence x: sorts it, sorts it into
+  decreasing order, sorts it and then swaps one percent of its
+  elements with random others, or sorts its first half into increasing
+  and its second half into decreasing order.
+  */
+  static
+  void
+  arrange(
+    Container<I>& x,
+    input_pattern pattern
+  ){
+    if (pattern == shuffled_input)
+      return;
+    std::sort(x.begin(), x.end());
+    if (pattern == reversed_input)
+      std::reverse(x.begin(), x.end());
+    else if (pattern == nearly_sorted_input)
+      for (size_t i = 0; i < x.size() / 100; ++i)
+        std::swap(x[std::rand() % x.size()], x[std::rand() % x.size()]);
+    else if (pattern == organ_pipe_input)
+      std::reverse(x.begin() + x.size() / 2, x.end());
+  }
+
+  /*
+  Times two sorting functions on the same uninstrumented sequences of
+  type Container<I>, checks both results, and reports the elapsed times
+  and the ratio of the first to the second.  The sequences are
+  permutations of 0, ..., N-1, or, if keys is positive, hold the values
+  0, ..., keys-1 about equally often; they are shuffled and then
+  arranged in the given pattern.
+  */
+  template <
+    typename BaselineSort,
+    typename Sort>
+  static
+  void
+  contrast(
+    const char* file_name,
+    const char* baseline_name,
+    BaselineSort baseline_sort,
+    const char* name,
+    Sort sort,
+    int keys = 0,
+    input_pattern pattern = shuffled_input
+  ){
+
+    const int factor = 1000;
+
+    cout << "All sequence sizes are in multiples of " << factor << ".\n";
+    cout << "Input the smallest sequence size: " << flush;
+    int N1;
+    cin >> N1;
+    cout << "Input the largest sequence sizes: " << flush;
+    int N2;
+    cin >> N2;
+
+    ofstream ofs(file_name);
+
+    int repetitions = max(32/N1, 1);
+    int width = 20;
+
+    cout << endl
+      << setw(width) << "Size"
+      << setw(width) << baseline_name
+      << setw(width) << name
+      << setw(width) << "Speedup"
+      << endl;
+
+    for (int N0 = N1; N0 <= N2; N0 *= 2) {
+
+      int N = N0 * factor;
+
+      Container<I> x;
+      for (int i = 0; i < N; ++i)
+        x.push_back(I(keys > 0 ? i % keys : i));
+      Container<I> sorted(x);
+      std::sort(sorted.begin(), sorted.end());
+
+      vector<double> baseline_times, times;
+
+      for (int p = 0; p < number_of_trials; ++p) {
+        std::random_shuffle(x.begin(), x.end());
+        arrange(x, pattern);
+        Container<I> y(x);
+
+        wall_timer stop_watch;
+        stop_watch.start();
+        for (int q = 0; q < repetitions; ++q) {
+          x = y;
+          baseline_sort(x);
+        }
+        stop_watch.stop();
+        baseline_times.push_back(stop_watch.lap_time());
+
+        assert(x == sorted);
+
+        stop_watch.start();
+        for (int q = 0; q < repetitions; ++q) {
+          x = y;
+          sort(x);
+        }
+        stop_watch.stop();
+        times.push_back(stop_watch.lap_time());
+
+        assert(x == sorted);
+      }
+
+      double baseline_time = median(baseline_times) / repetitions;
+      double time = median(times) / repetitions;
+
+      cout << setiosflags(ios::fixed) << setprecision(6)
+        << setw(width) << N0
+        << setw(width) << baseline_time
+        << setw(width) << time
+        << setw(width) << setprecision(3) << baseline_time / time
+        << endl;
+      ofs << setiosflags(ios::fixed) << setprecision(6)
+        << setw(4) << N0
+        << setw(width) << baseline_time
+        << setw(width) << time
+        << setw(width) << setprecision(3) << baseline_time / time
+        << endl;
+
+      if (repetitions > 1)
+        repetitions /= 2;
+    }
+  }
+
+  static
+  void
+  speedup(
+  ){
+    cout << "Input the number of threads (0 for all hardware threads): " << flush;
+    unsigned threads;
+    cin >> threads;
+
+    task_pool pool(threads == 0 ? std::thread::hardware_concurrency() : threads);
+    cout << "Threads: " << pool.size() << endl;
+
+    contrast("speedup.dat",
+             "Serial time",
+             [](Container<I>& x) {
+               introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+             },
+             "Parallel time",
+             [&pool](Container<I>& x) {
+               introsort(pool, x.begin(), x.end());
+             });
+  }
+
+  static
+  void
+  simd(
+  ){
+    contrast("simd.dat",
+             "Scalar time",
+             [](Container<I>& x) {
+               introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+             },
+             "Vector time",
+             [](Container<I>& x) {
+               introsort(x.begin(), x.end());
+             });
+  }
+
+  /*
+  Compares the parallel samplesort of samplesort.h with the parallel
+  introsort, both using every thread of one pool.
+  */
+  static
+  void
+  parallel_samplesort(
+  ){
+    cout << "Input the number of threads (0 for all hardware threads): " << flush;
+    unsigned threads;
+    cin >> threads;
+
+    task_pool pool(threads == 0 ? std::thread::hardware_concurrency() : threads);
+    cout << "Threads: " << pool.size() << endl;
+
+    contrast("samplesort.dat",
+             "Introsort time",
+             [&pool](Container<I>& x) {
+               introsort(pool, x.begin(), x.end());
+             },
+             "Samplesort time",
+             [&pool](Container<I>& x) {
+               samplesort(pool, x.begin(), x.end());
+             });
+  }
+
+  /*
+  Compares introsort with three_way_introsort on sequences with few
+  distinct keys.
+  */
+  static
+  void
+  duplicates(
+  ){
+    cout << "Input the number of distinct keys: " << flush;
+    int keys;
+    cin >> keys;
+
+    contrast("duplicates.dat",
+             "Introsort time",
+             [](Container<I>& x) {
+               introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+             },
+             "Three-way time",
+             [](Container<I>& x) {
+               three_way_introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+             },
+             keys);
+  }
+
+  /*
+  Compares introsort with adaptive_introsort on presorted, reversed
+  and other patterned inputs.
+  */
+  static
+  void
+  patterns(
+  ){
+    cout << "Input the pattern (0 shuffled, 1 sorted, 2 reversed, "
+         << "3 nearly sorted, 4 organ pipe): " << flush;
+    int pattern;
+    cin >> pattern;
+
+    contrast("patterns.dat",
+             "Introsort time",
+             [](Container<I>& x) {
+               introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+             },
+             "Adaptive time",
+             [](Container<I>& x) {
+               adaptive_introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+             },
+             0,
+             input_pattern(pattern));
+  }
+
+  /*
+  Compares the recursive introsort with iterative_introsort.
+  */
+  static
+  void
+  iterative(
+  ){
+    contrast("iterative.dat",
+             "Recursive time",
+             [](Container<I>& x) {
+               introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+             },
+             "Iterative time",
+             [](Container<I>& x) {
+               iterative_introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+             });
+  }
+
+  /*
+  Returns the median time per sort of sort applied repetitions times to
+  each of number_of_trials shuffled sequences of N values of type
+  Value, checking every result.
+  */
+  template <
+    typename Value,
+    typename Sort>
+  static
+  double
+  time_sort(
+    int N,
+    int repetitions,
+    Sort sort
+  ){
+    Container<Value> x;
+    for (int i = 0; i < N; ++i)
+      x.push_back(Value(I(i)));
+
+    vector<double> times;
+    for (int p = 0; p < number_of_trials; ++p) {
+      std::random_shuffle(x.begin(), x.end());
+      Container<Value> y(x);
+      wall_timer stop_watch;
+      stop_watch.start();
+      for (int q = 0; q < repetitions; ++q) {
+        x = y;
+        sort(x);
+      }
+      stop_watch.stop();
+      times.push_back(stop_watch.lap_time() / repetitions);
+
+      for (int z = 0; z < N; ++z)
+        assert(x[z] == Value(I(z)));
+    }
+    return median(times);
+  }
+
+  /*
+  Returns the median time of tuned_introsort with the given traits on
+  shuffled sequences of N values of type Value.
+  */
+  template <
+    typename Value,
+    typename Traits>
+  static
+  double
+  time_tuned(
+    int N
+  ){
+    return time_sort<Value>(N, 1, [](Container<Value>& x) {
+      tuned_introsort<Traits>(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+    });
+  }
+
+  template <
+    typename Value,
+    ptrdiff_t... Thresholds>
+  static
+  vector<double>
+  threshold_times(
+    int N,
+    std::integer_sequence<ptrdiff_t, Thresholds...>
+  ){
+    return {time_tuned<Value, fixed_introsort_traits<Thresholds> >(N)...};
+  }
+
+  template <
+    typename Value,
+    int... Multipliers>
+  static
+  vector<double>
+  depth_multiplier_times(
+    int N,
+    std::integer_sequence<int, Multipliers...>
+  ){
+    return {time_tuned<Value, fixed_introsort_traits<
+              introsort_traits<Value>::threshold, Multipliers> >(N)...};
+  }
+
+  /*
+  Times tuned_introsort with each of swept_thresholds on values of type
+  I and on records of 16, 64 and 256 bytes, and then with each of
+  swept_depth_multipliers and the default threshold, so that the
+  defaults of introsort_traits can be checked on the host.
+  */
+  static
+  void
+  thresholds(
+  ){
+    const int factor = 1000;
+
+    cout << "All sequence sizes are in multiples of " << factor << ".\n";
+    cout << "Input the sequence size: " << flush;
+    int N0;
+    cin >> N0;
+    int N = N0 * factor;
+
+    ofstream ofs("thresholds.dat");
+    int width = 14;
+
+    vector<vector<double> > columns = {
+      threshold_times<I>(N, swept_thresholds()),
+      threshold_times<record<I, 16> >(N, swept_thresholds()),
+      threshold_times<record<I, 64> >(N, swept_thresholds()),
+      threshold_times<record<I, 256> >(N, swept_thresholds())
+    };
+    const ptrdiff_t threshold[] = {4, 8, 12, 16, 24, 32, 48, 64};
+
+    cout << endl
+      << setw(width) << "Threshold"
+      << setw(width) << "Value"
+      << setw(width) << "16 bytes"
+      << setw(width) << "64 bytes"
+      << setw(width) << "256 bytes"
+      << endl;
+    for (size_t t = 0; t < columns[0].size(); ++t) {
+      cout << setw(width) << threshold[t];
+      ofs << setw(4) << threshold[t];
+      for (size_t c = 0; c < columns.size(); ++c) {
+        cout << setiosflags(ios::fixed) << setprecision(6) << setw(width) << columns[c][t];
+        ofs << setiosflags(ios::fixed) << setprecision(6) << setw(width) << columns[c][t];
+      }
+      cout << endl;
+      ofs << endl;
+    }
+    cout << "Defaults:"
+      << setw(width - 9) << ""
+      << setw(width) << introsort_traits<I>::threshold
+      << setw(width) << introsort_traits<record<I, 16> >::threshold
+      << setw(width) << introsort_traits<record<I, 64> >::threshold
+      << setw(width) << introsort_traits<record<I, 256> >::threshold
+      << endl;
+
+    vector<double> depth = depth_multiplier_times<I>(N, swept_depth_multipliers());
+    cout << endl
+      << setw(width) << "Depth factor"
+      << setw(width) << "Value"
+      << endl;
+    ofs << endl;
+    for (size_t m = 0; m < depth.size(); ++m) {
+      cout << setw(width) << m + 1
+        << setiosflags(ios::fixed) << setprecision(6) << setw(width) << depth[m]
+        << endl;
+      ofs << setw(4) << m + 1
+        << setiosflags(ios::fixed) << setprecision(6) << setw(width) << depth[m]
+        << endl;
+    }
+  }
+
+  /* Returns the index of the smallest time. */
+  static
+  size_t
+  fastest(
+    const vector<double>& times
+  ){
+    return std::min_element(times.begin(), times.end()) - times.begin();
+  }
+
+  /*
+  Returns the shortest length from 2^6 to 2^16 from which radix_sort
+  beats the comparison introsort on shuffled sequences of Key at every
+  length tried, or 2^17 if it never does.  Key should be a type that
+  introsort(first, last) radix sorts, not one it gives to
+  simd_introsort.
+  */
+  template <
+    typename Key>
+  static
+  ptrdiff_t
+  radix_crossover_length(
+  ){
+    static_assert(radix_traits<Key>::enabled, "Key needs a radix key");
+    auto less = __gnu_cxx::__ops::__iter_less_iter();
+    ptrdiff_t crossover = 1 << 17;
+    for (ptrdiff_t n = 1 << 16; n >= 1 << 6; n /= 2) {
+      int repetitions = max(int((1 << 20) / n), 1);
+      double comparison_time = time_sort<Key>(n, repetitions, [less](Container<Key>& x) {
+        introsort(x.begin(), x.end(), less);
+      });
+      double radix_time = time_sort<Key>(n, repetitions, [](Container<Key>& x) {
+        radix_sort(x.begin(), x.end());
+      });
+      if (comparison_time <= radix_time)
+        break;
+      crossover = n;
+    }
+    return crossover;
+  }
+
+  /*
+  Measures the candidates for each constant of tuning.h on the host and
+  writes the fastest ones to introsort_config.h in the current
+  directory, which tuning.h includes when the program is rebuilt in
+  that directory:
+
+    - the insertion sort thresholds of swept_thresholds, on values of
+      type I and on 256-byte records;
+    - the pivot selectors, with the default introsort_loop;
+    - parallel introsort grains from 2^10 to 2^18, on a pool of all
+      hardware threads;
+    - the radix crossovers: the shortest length from 2^6 to 2^16 from
+      which radix_sort beats introsort at every length tried, on
+      unsigned keys and on 64-bit ones.
+  */
+  static
+  void
+  autotune(
+  ){
+    const int factor = 1000;
+
+    cout << "All sequence sizes are in multiples of " << factor << ".\n";
+    cout << "Input the calibration sequence size: " << flush;
+    int N0;
+    cin >> N0;
+    int N = N0 * factor;
+    auto less = __gnu_cxx::__ops::__iter_less_iter();
+
+    const ptrdiff_t threshold[] = {4, 8, 12, 16, 24, 32, 48, 64};
+    ptrdiff_t small_threshold =
+      threshold[fastest(threshold_times<I>(N, swept_thresholds()))];
+    ptrdiff_t large_threshold =
+      threshold[fastest(threshold_times<record<I, 256> >(max(N / 8, 1), swept_thresholds()))];
+    cout << "Threshold: " << small_threshold
+         << ", large records: " << large_threshold << endl;
+
+    const char* pivot[] = {"median_of_3_pivot", "ninther_pivot",
+                           "sampled_pivot", "adaptive_pivot"};
+    vector<double> pivot_times = {
+      time_sort<I>(N, 1, [less](Container<I>& x) {
+        introsort(x.begin(), x.end(), less, hoare_partition(), median_of_3_pivot());
+      }),
+      time_sort<I>(N, 1, [less](Container<I>& x) {
+        introsort(x.begin(), x.end(), less, hoare_partition(), ninther_pivot());
+      }),
+      time_sort<I>(N, 1, [less](Container<I>& x) {
+        introsort(x.begin(), x.end(), less, hoare_partition(), sampled_pivot());
+      }),
+      time_sort<I>(N, 1, [less](Container<I>& x) {
+        introsort(x.begin(), x.end(), less, hoare_partition(), adaptive_pivot());
+      })
+    };
+    const char* best_pivot = pivot[fastest(pivot_times)];
+    cout << "Pivot: " << best_pivot << endl;
+
+    task_pool pool(std::thread::hardware_concurrency());
+    vector<ptrdiff_t> grains;
+    vector<double> grain_times;
+    for (ptrdiff_t grain = 1 << 10; grain <= 1 << 18; grain *= 4) {
+      grains.push_back(grain);
+      grain_times.push_back(time_sort<I>(N, 1, [&pool, less, grain](Container<I>& x) {
+        introsort(pool, x.begin(), x.end(), less, grain);
+      }));
+    }
+    ptrdiff_t grain = grains[fastest(grain_times)];
+    cout << "Parallel grain: " << grain << " (" << pool.size() << " threads)" << endl;
+
+    ptrdiff_t crossover = radix_crossover_length<unsigned>();
+    ptrdiff_t wide_crossover = radix_crossover_length<unsigned long long>();
+    cout << "Radix crossover: " << crossover
+         << ", 64-bit keys: " << wide_crossover << endl;
+
+    ofstream ofs("introsort_config.h");
+    ofs << "/*\n\n"
+        << "Tuning constants measured on this host by ``tsort3 autotune'',\n"
+        << "with sequences of " << N << " elements.  See tuning.h.\n\n"
+        << "*/\n\n"
+        << "#pragma once\n\n"
+        << "#define INTROSORT_THRESHOLD " << small_threshold << "\n"
+        << "#define INTROSORT_LARGE_THRESHOLD " << large_threshold << "\n"
+        << "#define INTROSORT_PIVOT " << best_pivot << "\n"
+        << "#define INTROSORT_PARALLEL_GRAIN " << grain << "\n"
+        << "#define INTROSORT_RADIX_CROSSOVER " << crossover << "\n"
+        << "#define INTROSORT_WIDE_RADIX_CROSSOVER " << wide_crossover << "\n";
+    cout << "Wrote introsort_config.h" << endl;
+  }
+
+  /*
+  Runs four selection algorithms on counted, shuffled sequences of N
+  elements for k = N/1000, N/100, N/10, N/2 and N, and reports the
+  median time and number of data comparisons of each: the heap-based
+  partial_sort and introselect_partial_sort, which sort the k smallest
+  elements, and std::nth_element and introselect, which find the k-th.
+  */
+  static
+  void
+  selection(
+  ){
+    const int factor = 1000;
+
+    cout << "All sequence sizes are in multiples of " << factor << ".\n";
+    cout << "Input the sequence size: " << flush;
+    int N0;
+    cin >> N0;
+    int N = N0 * factor;
+
+    Container<value_type> x;
+    for (int i = 0; i < N; ++i)
+      x.push_back(value_type(i));
+
+    const char* names[] = {"Heap partial", "Select partial", "nth_element", "Introselect"};
+    const int divisors[] = {1000, 100, 10, 2, 1};
+    ofstream ofs("selection.dat");
+    int width = 16;
+
+    cout << endl << setw(8) << "k/N";
+    for (int a = 0; a < 4; ++a)
+      cout << setw(width) << names[a] << setw(width) << "comparisons";
+    cout << endl;
+    cout << setiosflags(ios::fixed) << setprecision(6);
+    ofs << setiosflags(ios::fixed) << setprecision(6);
+
+    for (int d = 0; d < 5; ++d) {
+      int k = max(N / divisors[d], 1);
+      cout << setw(8) << 1.0 / divisors[d];
+      ofs << setw(8) << 1.0 / divisors[d];
+
+      for (int a = 0; a < 4; ++a) {
+        vector<double> times;
+        vector<ssize_t> comparisons;
+        for (int p = 0; p < number_of_trials; ++p) {
+          std::random_shuffle(x.begin(), x.end());
+          iterator first(x.begin()), middle(x.begin() + k), last(x.end());
+          value_type::comparisons = 0;
+          wall_timer stop_watch;
+          stop_watch.start();
+          switch (a) {
+          case 0: std::partial_sort(first, middle, last);
+            break;
+          case 1: introselect_partial_sort(first, middle, last);
+            break;
+          case 2: std::nth_element(first, middle - 1, last);
+            break;
+          case 3: introselect(first, middle - 1, last);
+            break;
+          }
+          stop_watch.stop();
+          times.push_back(stop_watch.lap_time());
+          comparisons.push_back(value_type::comparisons);
+
+          if (a < 2)
+            for (int z = 0; z < k; ++z)
+              assert(x[z] == value_type(z));
+          else
+            assert(x[k - 1] == value_type(k - 1));
+        }
+        double time = median(times);
+        ssize_t count = median(comparisons);
+        cout << setw(width) << time << setw(width) << count;
+        ofs << setw(width) << time << setw(width) << count;
+      }
+      cout << endl;
+      ofs << endl;
+    }
+  }
+
+  /*
+  Sorts shuffled sequences of N counted values by a key that takes a
+  number of rounds of integer mixing to compute from each value, once
+  with introsort and a comparator that computes the keys of both its
+  arguments, and once with the projected_introsort of projsort.h, and
+  reports the median time and the numbers of key computations (the
+  accesses of the counted values) and assignments of each.
+  */
+  static
+  void
+  projection(
+  ){
+    const int factor = 1000;
+
+    cout << "All sequence sizes are in multiples of " << factor << ".\n";
+    cout << "Input the sequence size: " << flush;
+    int N0;
+    cin >> N0;
+    int N = N0 * factor;
+
+    Container<value_type> x;
+    for (int i = 0; i < N; ++i)
+      x.push_back(value_type(i));
+
+    auto key = [](const value_type& v) {
+      unsigned long long k = v.base();
+      for (int round = 0; round < 16; ++round) {
+        k ^= k >> 31;
+        k *= 0x9e3779b97f4a7c15ULL;
+      }
+      return k;
+    };
+
+    const char* names[] = {"Comparator keys", "Projected keys"};
+    ofstream ofs("projection.dat");
+    int width = 16;
+
+    cout << endl << setw(width) << "" << setw(width) << "time"
+      << setw(width) << "keys" << setw(width) << "assignments" << endl;
+    cout << setiosflags(ios::fixed) << setprecision(6);
+    ofs << setiosflags(ios::fixed) << setprecision(6);
+
+    for (int a = 0; a < 2; ++a) {
+      vector<double> times;
+      vector<ssize_t> keys, assignments;
+      for (int p = 0; p < number_of_trials; ++p) {
+        std::random_shuffle(x.begin(), x.end());
+        value_type::reset();
+        wall_timer stop_watch;
+        stop_watch.start();
+        if (a == 0)
+          introsort(x.begin(), x.end(),
+                    __gnu_cxx::__ops::__iter_comp_iter(
+                      [&key](const value_type& u, const value_type& v) {
+                        return key(u) < key(v);
+                      }));
+        else
+          projected_introsort(x.begin(), x.end(), key);
+        stop_watch.stop();
+        times.push_back(stop_watch.lap_time());
+        keys.push_back(value_type::accesses);
+        assignments.push_back(value_type::assignments);
+
+        for (int i = 1; i < N; ++i)
+          assert(!(key(x[i]) < key(x[i - 1])));
+      }
+      cout << setw(width) << names[a] << setw(width) << median(times)
+        << setw(width) << median(keys) << setw(width) << median(assignments) << endl;
+      ofs << setw(width) << names[a] << setw(width) << median(times)
+        << setw(width) << median(keys) << setw(width) << median(assignments) << endl;
+    }
+  }
+
+  /* Returns the times of introsort and indirect_introsort on values of
+     type Value. */
+  template <
+    typename Value>
+  static
+  std::pair<double, double>
+  indirect_times(
+    int N
+  ){
+    double direct = time_sort<Value>(N, 1, [](Container<Value>& x) {
+      introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+    });
+    double indirect = time_sort<Value>(N, 1, [](Container<Value>& x) {
+      indirect_introsort(x.begin(), x.end());
+    });
+    return std::make_pair(direct, indirect);
+  }
+
+  /*
+  Compares introsort with the indirect_introsort of projsort.h, which
+  sorts indices and then moves each record once, on values of type I
+  and on records of 16 to 1024 bytes.
+  */
+  static
+  void
+  indirect(
+  ){
+    const int factor = 1000;
+
+    cout << "All sequence sizes are in multiples of " << factor << ".\n";
+    cout << "Input the sequence size: " << flush;
+    int N0;
+    cin >> N0;
+    int N = N0 * factor;
+
+    ofstream ofs("indirect.dat");
+    int width = 16;
+
+    const char* names[] = {"Value", "16 bytes", "64 bytes", "256 bytes", "1024 bytes"};
+    const int bytes[] = {int(sizeof(I)), 16, 64, 256, 1024};
+    vector<std::pair<double, double> > times = {
+      indirect_times<I>(N),
+      indirect_times<record<I, 16> >(N),
+      indirect_times<record<I, 64> >(N),
+      indirect_times<record<I, 256> >(N),
+      indirect_times<record<I, 1024> >(N)
+    };
+
+    cout << endl << setw(width) << "Record" << setw(width) << "Direct time"
+      << setw(width) << "Indirect time" << setw(width) << "Speedup" << endl;
+    for (size_t r = 0; r < times.size(); ++r) {
+      double speedup = times[r].first / times[r].second;
+      cout << setw(width) << names[r]
+        << setiosflags(ios::fixed) << setprecision(6)
+        << setw(width) << times[r].first << setw(width) << times[r].second
+        << setprecision(3) << setw(width) << speedup << endl;
+      ofs << setw(6) << bytes[r]
+        << setiosflags(ios::fixed) << setprecision(6)
+        << setw(width) << times[r].first << setw(width) << times[r].second
+        << setprecision(3) << setw(width) << speedup << endl;
+    }
+  }
+
+  /*
+  Sorts M segments of random lengths from L1 to L2 elements of a flat
+  sequence of random values of type I, by calling introsort on each
+  segment, with the segmented_sort of segsort.h and with its parallel
+  overload, and reports the median time of each and the number of
+  segments sorted per second.
+  */
+  static
+  void
+  segments(
+  ){
+    cout << "Input the number of threads (0 for all hardware threads): " << flush;
+    unsigned threads;
+    cin >> threads;
+
+    task_pool pool(threads == 0 ? std::thread::hardware_concurrency() : threads);
+    cout << "Threads: " << pool.size() << endl;
+
+    const int factor = 1000;
+
+    cout << "All segment counts are in multiples of " << factor << ".\n";
+    cout << "Input the number of segments: " << flush;
+    int M0;
+    cin >> M0;
+    int M = M0 * factor;
+
+    cout << "Input the smallest and the largest segment length: " << flush;
+    int L1, L2;
+    cin >> L1 >> L2;
+
+    std::mt19937 generator(M);
+    std::uniform_int_distribution<int> length(L1, L2);
+    vector<ptrdiff_t> offsets(1, 0);
+    for (int m = 0; m < M; ++m)
+      offsets.push_back(offsets.back() + length(generator));
+    Container<I> y;
+    for (ptrdiff_t i = 0; i < offsets.back(); ++i)
+      y.push_back(I(generator()));
+
+    const char* names[] = {"Introsort each", "Segmented", "Parallel segmented"};
+    ofstream ofs("segments.dat");
+    int width = 20;
+
+    cout << endl << setw(width) << "" << setw(width) << "Time"
+      << setw(width) << "Segments/s" << endl;
+    cout << setiosflags(ios::fixed) << setprecision(6);
+    ofs << setiosflags(ios::fixed) << setprecision(6);
+
+    for (int a = 0; a < 3; ++a) {
+      vector<double> times;
+      for (int p = 0; p < number_of_trials; ++p) {
+        Container<I> x(y);
+        wall_timer stop_watch;
+        stop_watch.start();
+        switch (a) {
+        case 0:
+          for (int m = 0; m < M; ++m)
+            if (offsets[m + 1] - offsets[m] > 1)
+              introsort(x.begin() + offsets[m], x.begin() + offsets[m + 1]);
+          break;
+        case 1: segmented_sort(x.begin(), offsets.begin(), offsets.end());
+          break;
+        case 2: segmented_sort(pool, x.begin(), offsets.begin(), offsets.end());
+          break;
+        }
+        stop_watch.stop();
+        times.push_back(stop_watch.lap_time());
+
+        for (int m = 0; m < M; ++m)
+          assert(std::is_sorted(x.begin() + offsets[m], x.begin() + offsets[m + 1]));
+      }
+      double time = median(times);
+      cout << setw(width) << names[a] << setw(width) << time
+        << setprecision(0) << setw(width) << M / time << setprecision(6) << endl;
+      ofs << setw(width) << names[a] << setw(width) << time
+        << setprecision(0) << setw(width) << M / time << setprecision(6) << endl;
+    }
+  }
+
+  /*
+  Appends batches of B random values of type I to sorted sequences of N
+  random values, for B/N from 1/1000 to 1, and reports the median time
+  per append of sorting the whole sequence again with introsort, and of
+  incremental_sort from incsort.h with the default scratch memory and
+  with none.
+  */
+  static
+  void
+  incremental(
+  ){
+    const int factor = 1000;
+
+    cout << "All sequence sizes are in multiples of " << factor << ".\n";
+    cout << "Input the sequence size: " << flush;
+    int N0;
+    cin >> N0;
+    int N = N0 * factor;
+
+    std::mt19937 generator(N);
+    Container<I> sorted;
+    for (int i = 0; i < N; ++i)
+      sorted.push_back(I(generator()));
+    std::sort(sorted.begin(), sorted.end());
+
+    const int divisors[] = {1000, 100, 10, 2, 1};
+    const char* names[] = {"Re-sort", "Buffered merge", "In-place merge"};
+    ofstream ofs("incremental.dat");
+    int width = 16;
+
+    cout << endl << setw(8) << "B/N";
+    for (int a = 0; a < 3; ++a)
+      cout << setw(width) << names[a];
+    cout << endl;
+    cout << setiosflags(ios::fixed) << setprecision(6);
+    ofs << setiosflags(ios::fixed) << setprecision(6);
+
+    for (int d = 0; d < 5; ++d) {
+      int B = max(N / divisors[d], 1);
+      cout << setw(8) << 1.0 / divisors[d];
+      ofs << setw(8) << 1.0 / divisors[d];
+
+      for (int a = 0; a < 3; ++a) {
+        vector<double> times;
+        for (int p = 0; p < number_of_trials; ++p) {
+          Container<I> x(sorted);
+          for (int i = 0; i < B; ++i)
+            x.push_back(I(generator()));
+          Container<I> expected(x);
+          std::sort(expected.begin(), expected.end());
+
+          wall_timer stop_watch;
+          stop_watch.start();
+          switch (a) {
+          case 0: introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+            break;
+          case 1: incremental_sort(x.begin(), x.begin() + N, x.end(),
+                                   __gnu_cxx::__ops::__iter_less_iter());
+            break;
+          case 2: incremental_sort(x.begin(), x.begin() + N, x.end(),
+                                   __gnu_cxx::__ops::__iter_less_iter(), 0);
+            break;
+          }
+          stop_watch.stop();
+          times.push_back(stop_watch.lap_time());
+
+          assert(x == expected);
+        }
+        cout << setw(width) << median(times);
+        ofs << setw(width) << median(times);
+      }
+      cout << endl;
+      ofs << endl;
+    }
+  }
+
+  /* Returns the times of introsort and its dual- and three-pivot
+     versions on values of type Value. */
+  template <
+    typename Value>
+  static
+  vector<double>
+  multipivot_times(
+    int N
+  ){
+    return {
+      time_sort<Value>(N, 1, [](Container<Value>& x) {
+        introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+      }),
+      time_sort<Value>(N, 1, [](Container<Value>& x) {
+        dual_pivot_introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+      }),
+      time_sort<Value>(N, 1, [](Container<Value>& x) {
+        three_pivot_introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+      })
+    };
+  }
+
+  /*
+  Times introsort, dual_pivot_introsort and three_pivot_introsort on
+  sequences of N values of type I and of 64-byte records, for N from
+  N1 to N2 doubling.
+  */
+  static
+  void
+  multipivot(
+  ){
+    const int factor = 1000;
+
+    cout << "All sequence sizes are in multiples of " << factor << ".\n";
+    cout << "Input the smallest sequence size: " << flush;
+    int N1;
+    cin >> N1;
+    cout << "Input the largest sequence sizes: " << flush;
+    int N2;
+    cin >> N2;
+
+    ofstream ofs("multipivot.dat");
+    int width = 14;
+
+    cout << endl << setw(6) << "Size" << setw(width) << "Introsort"
+      << setw(width) << "Dual-pivot" << setw(width) << "Three-pivot"
+      << setw(width) << "64 bytes" << setw(width) << "Dual-pivot"
+      << setw(width) << "Three-pivot" << endl;
+    cout << setiosflags(ios::fixed) << setprecision(6);
+    ofs << setiosflags(ios::fixed) << setprecision(6);
+
+    for (int N0 = N1; N0 <= N2; N0 *= 2) {
+      int N = N0 * factor;
+      vector<double> times = multipivot_times<I>(N);
+      vector<double> record_times = multipivot_times<record<I, 64> >(N);
+      times.insert(times.end(), record_times.begin(), record_times.end());
+
+      cout << setw(6) << N0;
+      ofs << setw(6) << N0;
+      for (size_t t = 0; t < times.size(); ++t) {
+        cout << setw(width) << times[t];
+        ofs << setw(width) << times[t];
+      }
+      cout << endl;
+      ofs << endl;
+    }
+  }
+
+  /*
+  Compares radix_sort with the comparison introsort that
+  introsort(first, last) uses below the crossover, to locate
+  radix_crossover or wide_radix_crossover.  I should be a type that
+  introsort(first, last) radix sorts, such as unsigned or a 64-bit
+  integer, not int, which it gives to simd_introsort where the
+  processor allows.
+  */
+  static
+  void
+  radix(
+  ){
+    contrast("radix.dat",
+             "Introsort time",
+             [](Container<I>& x) {
+               introsort(x.begin(), x.end(), __gnu_cxx::__ops::__iter_less_iter());
+             },
+             "Radix sort time",
+             [](Container<I>& x) {
+               radix_sort(x.begin(), x.end());
+             });
+  }
+
+  /*
+  Sorts a binary file of values of type I with external_sort into a
+  file of the same name with ".sorted" appended, checks the result and
+  reports the throughput of each phase in bytes per second.  If the
+  file does not exist, it is first filled with random values.
+  */
+  static
+  void
+  external(
+  ){
+    const size_t factor = 1000000;
+
+    cout << "Input the name of the file to sort: " << flush;
+    std::string input;
+    cin >> input;
+
+    if (::access(input.c_str(), F_OK) != 0) {
+      cout << "Input the number of values to generate, in multiples of "
+           << factor << ": " << flush;
+      size_t N0;
+      cin >> N0;
+      std::mt19937 generator(N0);
+      vector<I> block(factor);
+      int fd = external_create(input);
+      for (size_t b = 0; b < N0; ++b) {
+        for (size_t i = 0; i < factor; ++i)
+          block[i] = I(generator());
+        external_write(fd, block.data(), factor * sizeof(I), off_t(b * factor * sizeof(I)));
+      }
+      ::close(fd);
+    }
+
+    cout << "Input the memory budget in megabytes: " << flush;
+    size_t megabytes;
+    cin >> megabytes;
+
+    std::string output = input + ".sorted";
+    external_sort_report report = external_sort<I>(input, output, megabytes << 20);
+
+    {
+      mapped_file result(output);
+      const I* first = reinterpret_cast<const I*>(result.data());
+      assert(result.size() == report.bytes);
+      assert(std::is_sorted(first, first + result.size() / sizeof(I)));
+    }
+
+    ofstream ofs("external.dat");
+    int width = 20;
+    double megabyte = 1 << 20;
+
+    cout << endl
+      << "Bytes: " << report.bytes << "   Runs: " << report.runs << endl
+      << setw(width) << "Phase"
+      << setw(width) << "Time"
+      << setw(width) << "MB/s"
+      << endl;
+
+    const char* phases[] = {"Run read", "Run sort", "Run write", "Merge", "Total"};
+    double times[] = {report.read_time, report.sort_time, report.write_time,
+                      report.merge_time, report.total_time};
+    for (int i = 0; i < 5; ++i) {
+      double rate = times[i] > 0 ? report.bytes / megabyte / times[i] : 0;
+      cout << setiosflags(ios::fixed) << setprecision(6)
+        << setw(width) << phases[i]
+        << setw(width) << times[i]
+        << setw(width) << setprecision(1) << rate
+        << endl;
+      ofs << setiosflags(ios::fixed) << setprecision(6)
+        << setw(width) << phases[i]
+        << setw(width) << times[i]
+        << setw(width) << setprecision(1) << rate
+        << endl;
+    }
+  }
 };
@@ -0,0 +1,376 @@
+/*
+
+Defines external_sort, which sorts a binary file of values of a
+trivially copyable type T into another file when the file may be
+larger than main memory.  It works in two phases:
+
+  - run formation reads the input through a read-only memory mapping
+    in chunks of half the memory budget, sorts each chunk with
+    introsort and writes it to a temporary file of sorted runs.  Two
+    chunk buffers alternate, so that a background thread writes one
+    run while the next one is read and sorted;
+  - the merge maps the run file, keeps a heap of the current element
+    of every run and writes the merged output in blocks of
+    external_block_bytes, again from two alternating buffers, one of
+    which is being written by a background thread while the other is
+    filled.  Each run is read ahead one block at a time with
+    MADV_WILLNEED, so the kernel fetches the next block of every run
+    while the current one is being merged.
+
+All runs are merged in one pass.  external_sort returns the byte count
+and the time spent in each phase in an external_sort_report; the read,
+sort and write times of run formation are measured on the thread that
+does the work, so they overlap in elapsed time.
+
+Errors of the underlying system calls are thrown as std::system_error.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <future>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "intsort.h"
+#include "timer.h"
+
+const size_t external_block_bytes = 1 << 22;
+
+inline
+void
+external_error(
+  const std::string& what
+){
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+/* A file mapped read-only into memory for the lifetime of the object. */
+class mapped_file {
+protected:
+  int fd;
+  char* bytes;
+  size_t length;
+
+public:
+  explicit
+  mapped_file(
+    const std::string& path
+  ) : fd(-1), bytes(nullptr), length(0) {
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      external_error(path);
+    struct stat status;
+    if (::fstat(fd, &status) < 0) {
+      ::close(fd);
+      external_error(path);
+    }
+    length = status.st_size;
+    if (length > 0) {
+      void* p = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+      if (p == MAP_FAILED) {
+        ::close(fd);
+        external_error(path);
+      }
+      bytes = static_cast<char*>(p);
+      ::madvise(bytes, length, MADV_SEQUENTIAL);
+    }
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  ~mapped_file(
+  ){
+    if (bytes)
+      ::munmap(bytes, length);
+    ::close(fd);
+  }
+
+  const char*
+  data(
+  ) const {
+    return bytes;
+  }
+
+  size_t
+  size(
+  ) const {
+    return length;
+  }
+
+  /* Asks the kernel to start reading [offset, offset + count). */
+  void
+  will_need(
+    size_t offset,
+    size_t count
+  ) const {
+    if (offset >= length)
+      return;
+    size_t page = ::sysconf(_SC_PAGESIZE);
+    size_t start = offset / page * page;
+    ::madvise(bytes + start, std::min(count + (offset - start), length - start),
+              MADV_WILLNEED);
+  }
+};
+
+/* Writes count bytes at offset, returning the time it took. */
+inline
+double
+external_write(
+  int fd,
+  const void* buffer,
+  size_t count,
+  off_t offset
+){
+  wall_timer stop_watch;
+  stop_watch.start();
+  const char* p = static_cast<const char*>(buffer);
+  while (count > 0) {
+    ssize_t written = ::pwrite(fd, p, count, offset);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      external_error("pwrite");
+    }
+    p += written;
+    offset += written;
+    count -= written;
+  }
+  stop_watch.stop();
+  return stop_watch.lap_time();
+}
+
+inline
+int
+external_create(
+  const std::string& path
+){
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    external_error(path);
+  return fd;
+}
+
+struct external_sort_report {
+  size_t bytes;
+  size_t runs;
+  double read_time;
+  double sort_time;
+  double write_time;
+  double merge_time;
+  double total_time;
+};
+
+/* Sorts the runs of [first, first + n) into run_fd and returns their
+   bounds. */
+template <
+  typename T,
+  typename Sort>
+std::vector<std::pair<size_t, size_t> >
+external_form_runs(
+  const T* first,
+  size_t n,
+  int run_fd,
+  size_t run_length,
+  Sort sort,
+  external_sort_report& report
+){
+  std::vector<std::pair<size_t, size_t> > runs;
+  std::vector<T> buffers[2];
+  buffers[0].resize(std::min(run_length, n));
+  buffers[1].resize(n > run_length ? std::min(run_length, n - run_length) : 0);
+  std::future<double> pending;
+
+  for (size_t start = 0; start < n; start += run_length) {
+    size_t count = std::min(run_length, n - start);
+    std::vector<T>& buffer = buffers[runs.size() % 2];
+
+    wall_timer stop_watch;
+    stop_watch.start();
+    std::copy(first + start, first + start + count, buffer.begin());
+    stop_watch.stop();
+    report.read_time += stop_watch.lap_time();
+
+    stop_watch.start();
+    sort(buffer.begin(), buffer.begin() + count);
+    stop_watch.stop();
+    report.sort_time += stop_watch.lap_time();
+
+    if (pending.valid())
+      report.write_time += pending.get();
+    pending = std::async(std::launch::async, external_write, run_fd,
+                         buffer.data(), count * sizeof(T), off_t(start * sizeof(T)));
+    runs.push_back(std::make_pair(start, start + count));
+  }
+  if (pending.valid())
+    report.write_time += pending.get();
+  return runs;
+}
+
+/* Merges the sorted runs of the mapped run file into out_fd. */
+template <
+  typename T,
+  typename Compare>
+void
+external_merge(
+  const mapped_file& run_file,
+  const std::vector<std::pair<size_t, size_t> >& runs,
+  int out_fd,
+  Compare comp
+){
+  struct cursor {
+    const T* next;
+    const T* last;
+    const T* fetched;
+  };
+
+  const T* base = reinterpret_cast<const T*>(run_file.data());
+  const size_t block = std::max(external_block_bytes / sizeof(T), size_t(1));
+
+  std::vector<cursor> cursors;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    cursor c = {base + runs[i].first, base + runs[i].second, base + runs[i].first};
+    cursors.push_back(c);
+    run_file.will_need(runs[i].first * sizeof(T), block * sizeof(T));
+  }
+
+  /* Heap of run indices with the run of the smallest element on top. */
+  std::vector<size_t> heap;
+  for (size_t i = 0; i < cursors.size(); ++i)
+    if (cursors[i].next != cursors[i].last)
+      heap.push_back(i);
+  auto run_less = [&cursors, &comp](size_t a, size_t b) {
+    return comp(cursors[a].next, cursors[b].next);
+  };
+  auto sift_down = [&heap, &run_less](size_t hole) {
+    size_t n = heap.size();
+    size_t top = heap[hole];
+    for (;;) {
+      size_t child = 2 * hole + 1;
+      if (child >= n)
+        break;
+      if (child + 1 < n && run_less(heap[child + 1], heap[child]))
+        ++child;
+      if (!run_less(heap[child], top))
+        break;
+      heap[hole] = heap[child];
+      hole = child;
+    }
+    heap[hole] = top;
+  };
+  for (size_t i = heap.size() / 2; i-- > 0; )
+    sift_down(i);
+
+  std::vector<T> buffers[2] = {std::vector<T>(block), std::vector<T>(block)};
+  std::future<double> pending;
+  size_t filled = 0, written = 0, current = 0;
+
+  while (!heap.empty()) {
+    cursor& c = cursors[heap.front()];
+    if (c.next == c.fetched) {
+      size_t offset = (c.fetched - base) * sizeof(T);
+      run_file.will_need(offset + block * sizeof(T), block * sizeof(T));
+      c.fetched = std::min(c.fetched + block, c.last);
+    }
+    buffers[current][filled++] = *c.next++;
+    if (c.next == c.last) {
+      heap.front() = heap.back();
+      heap.pop_back();
+    }
+    if (!heap.empty())
+      sift_down(0);
+
+    if (filled == block || heap.empty()) {
+      if (pending.valid())
+        pending.get();
+      pending = std::async(std::launch::async, external_write, out_fd,
+                           buffers[current].data(), filled * sizeof(T),
+                           off_t(written * sizeof(T)));
+      written += filled;
+      filled = 0;
+      current = 1 - current;
+    }
+  }
+  if (pending.valid())
+    pending.get();
+}
+
+template <
+  typename T,
+  typename Compare,
+  typename Sort>
+external_sort_report
+external_sort(
+  const std::string& input,
+  const std::string& output,
+  size_t memory_bytes,
+  Compare comp,
+  Sort sort
+){
+  static_assert(std::is_trivially_copyable<T>::value,
+                "external_sort reads and writes values as raw bytes");
+
+  external_sort_report report = external_sort_report();
+  wall_timer total;
+  total.start();
+
+  mapped_file in(input);
+  size_t n = in.size() / sizeof(T);
+  report.bytes = n * sizeof(T);
+  size_t run_length = std::max(memory_bytes / 2 / sizeof(T), size_t(1));
+
+  std::string run_path = output + ".runs";
+  int run_fd = external_create(run_path);
+  std::vector<std::pair<size_t, size_t> > runs =
+    external_form_runs(reinterpret_cast<const T*>(in.data()), n, run_fd,
+                       run_length, sort, report);
+  ::close(run_fd);
+  report.runs = runs.size();
+
+  wall_timer stop_watch;
+  stop_watch.start();
+  {
+    mapped_file run_file(run_path);
+    int out_fd = external_create(output);
+    external_merge<T>(run_file, runs, out_fd, comp);
+    ::close(out_fd);
+  }
+  ::unlink(run_path.c_str());
+  stop_watch.stop();
+  report.merge_time = stop_watch.lap_time();
+
+  total.stop();
+  report.total_time = total.lap_time();
+  return report;
+}
+
+/* Sorts the runs with the dispatching introsort of intsort.h and merges
+   them by operator<. */
+template <
+  typename T>
+inline
+external_sort_report
+external_sort(
+  const std::string& input,
+  const std::string& output,
+  size_t memory_bytes
+){
+  typedef typename std::vector<T>::iterator iterator;
+  return external_sort<T>(input, output, memory_bytes,
+                          __gnu_cxx::__ops::__iter_less_iter(),
+                          [](iterator first, iterator last) {
+                            introsort(first, last);
+                          });
+}
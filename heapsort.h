@@ -0,0 +1,213 @@
+/*
+
+Defines bottom_up_heapsort and dary_heapsort, and the heap policies
+bottom_up_heap, dary_heap and cache_line_heap that select one of them
+as the heapsort introsort_loop and its variants fall back on when the
+depth limit runs out (see introsort_traits in intsort.h).  The default
+is bottom_up_heap.
+
+Both sift with Wegener's bottom-up strategy: the hole left at a node is
+moved down along the path of largest children all the way to a leaf,
+with Arity - 1 comparisons per level, and the element being sifted is
+then moved up from the leaf to its place, which is usually within a
+level or two.  The usual sift compares the element with the largest
+child at every level as well, so for a binary heap the bottom-up sift
+takes about N log N comparisons instead of about 2 N log N.
+
+bottom_up_heapsort uses a binary heap with a single root.  dary_heapsort
+uses a heap of Arity-way nodes laid out so that every group of
+siblings, including the top level of Arity roots, starts at a multiple
+of Arity from first: the children of node i are
+Arity * i + Arity, ..., Arity * i + 2 * Arity - 1, and the largest
+element is the largest of the first Arity.  When Arity * sizeof(T) is
+the cache line size, as cache_line_heap_arity<T> chooses it, and first
+is aligned to a cache line, every sibling group is exactly one line,
+so each level of a sift touches one line.  Nothing aligns first: the
+storage of a std::vector is usually aligned only to 16 bytes, so a
+group then straddles two lines, and with smaller Arity, such as 4 or
+8 for int, a group fills only part of one.
+
+*/
+
+#pragma once
+
+#include <iterator>
+#include <utility>
+
+/*
+Fills the hole at node hole of the heap [first, first + len) with
+value.  Nodes below Roots are the roots; the children of node i are
+Arity * i + Roots, ..., Arity * i + Roots + Arity - 1.
+*/
+template <
+  int Arity,
+  int Roots,
+  typename RandomAccessIterator,
+  typename Distance,
+  typename T,
+  typename Compare>
+void
+heap_sift_bottom_up(
+  RandomAccessIterator first,
+  Distance hole,
+  Distance len,
+  T value,
+  Compare comp
+){
+  const Distance top = hole;
+  Distance child = hole * Arity + Roots;
+  while (!(len - Arity < child)) {
+    Distance largest = child;
+    for (int i = 1; i < Arity; ++i)
+      if (comp(first + largest, first + (child + i)))
+        largest = child + i;
+    *(first + hole) = std::move(*(first + largest));
+    hole = largest;
+    child = hole * Arity + Roots;
+  }
+  if (child < len) {
+    Distance largest = child;
+    for (++child; child < len; ++child)
+      if (comp(first + largest, first + child))
+        largest = child;
+    *(first + hole) = std::move(*(first + largest));
+    hole = largest;
+  }
+  auto comp_value = __gnu_cxx::__ops::__iter_comp_val(comp);
+  while (top < hole) {
+    Distance parent = (hole - Roots) / Arity;
+    if (!comp_value(first + parent, value))
+      break;
+    *(first + hole) = std::move(*(first + parent));
+    hole = parent;
+  }
+  *(first + hole) = std::move(value);
+}
+
+template <
+  int Arity,
+  int Roots,
+  typename RandomAccessIterator,
+  typename Compare>
+void
+heapsort_bottom_up(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  Distance len = last - first;
+  if (len < Distance(2))
+    return;
+
+  if (Distance(Roots) < len)
+    for (Distance i = (len - Roots - 1) / Arity + 1; Distance(0) < i; ) {
+      --i;
+      T value = std::move(*(first + i));
+      heap_sift_bottom_up<Arity, Roots>(first, i, len, std::move(value), comp);
+    }
+
+  while (Distance(1) < len) {
+    Distance largest = 0;
+    Distance roots = len < Distance(Roots) ? len : Distance(Roots);
+    for (Distance r = 1; r < roots; ++r)
+      if (comp(first + largest, first + r))
+        largest = r;
+    --len;
+    if (largest == len)
+      continue;
+    T value = std::move(*(first + len));
+    *(first + len) = std::move(*(first + largest));
+    heap_sift_bottom_up<Arity, Roots>(first, largest, len, std::move(value), comp);
+  }
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+bottom_up_heapsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  heapsort_bottom_up<2, 1>(first, last, comp);
+}
+
+template <
+  int Arity,
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+dary_heapsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  heapsort_bottom_up<Arity, Arity>(first, last, comp);
+}
+
+/*
+The arity at which a sibling group of dary_heapsort is one cache line
+of values of type T, or 2 if a line holds fewer than two of them or
+not a whole number.
+*/
+template <
+  typename T>
+struct cache_line_heap_arity {
+  static constexpr int value =
+    sizeof(T) <= 32 && 64 % sizeof(T) == 0 ? int(64 / sizeof(T)) : 2;
+};
+
+/*
+Heap policies for the fallback of introsort_traits: each sorts
+[first, last) with one of the heapsorts above.
+*/
+struct bottom_up_heap {
+  template <
+    typename RandomAccessIterator,
+    typename Compare>
+  void
+  operator()(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    Compare comp
+  ) const {
+    bottom_up_heapsort(first, last, comp);
+  }
+};
+
+template <
+  int Arity>
+struct dary_heap {
+  template <
+    typename RandomAccessIterator,
+    typename Compare>
+  void
+  operator()(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    Compare comp
+  ) const {
+    dary_heapsort<Arity>(first, last, comp);
+  }
+};
+
+struct cache_line_heap {
+  template <
+    typename RandomAccessIterator,
+    typename Compare>
+  void
+  operator()(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    Compare comp
+  ) const {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+    dary_heapsort<cache_line_heap_arity<T>::value>(first, last, comp);
+  }
+};
@@ -0,0 +1,194 @@
+/*
+
+Defines incremental_sort, for sorted sequences that grow by appending
+batches of new elements: given [first, middle) sorted and a batch
+appended in [middle, last), it sorts only the batch with introsort and
+then merges it into the sorted part, instead of sorting all of
+[first, last) again.
+
+The merge, merge_adaptive, first trims the elements that are already in
+place at both ends, which is all of them when the batch sorts after
+the old elements.  It then merges through a scratch buffer of up to
+scratch_bytes bytes.  When the shorter of the two runs fits in the
+buffer, that run is moved out and the merge writes every element once.
+Otherwise the runs are split, the middle pieces rotated into place and
+the halves merged recursively, as in the buffer-less merges of the
+STL, until the pieces fit; with no buffer at all this takes
+O(N log N) moves.  The merge is stable, though introsort, which sorts
+the batch, is not.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "intsort.h"
+
+const size_t incremental_scratch_bytes = size_t(1) << 24;
+
+/* Merges [first, middle) and [middle, last), the first of which fits
+   in buffer. */
+template <
+  typename RandomAccessIterator,
+  typename Pointer,
+  typename Compare>
+void
+merge_forward(
+  RandomAccessIterator first,
+  RandomAccessIterator middle,
+  RandomAccessIterator last,
+  Pointer buffer,
+  Compare comp
+){
+  Pointer buffer_last = std::move(first, middle, buffer);
+  while (buffer != buffer_last && middle != last) {
+    if (comp(middle, buffer)) {
+      *first = std::move(*middle);
+      ++middle;
+    } else {
+      *first = std::move(*buffer);
+      ++buffer;
+    }
+    ++first;
+  }
+  std::move(buffer, buffer_last, first);
+}
+
+/* Merges [first, middle) and [middle, last), the second of which fits
+   in buffer. */
+template <
+  typename RandomAccessIterator,
+  typename Pointer,
+  typename Compare>
+void
+merge_backward(
+  RandomAccessIterator first,
+  RandomAccessIterator middle,
+  RandomAccessIterator last,
+  Pointer buffer,
+  Compare comp
+){
+  Pointer buffer_last = std::move(middle, last, buffer);
+  while (buffer != buffer_last && first != middle) {
+    if (comp(buffer_last - 1, middle - 1))
+      *--last = std::move(*--middle);
+    else
+      *--last = std::move(*--buffer_last);
+  }
+  std::move_backward(buffer, buffer_last, last);
+}
+
+/*
+Merges the sorted ranges [first, middle) and [middle, last) with the
+help of a buffer of buffer_size elements, which may be zero.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Pointer,
+  typename Distance,
+  typename Compare>
+void
+merge_adaptive(
+  RandomAccessIterator first,
+  RandomAccessIterator middle,
+  RandomAccessIterator last,
+  Pointer buffer,
+  Distance buffer_size,
+  Compare comp
+){
+  if (first == middle || middle == last || !comp(middle, middle - 1))
+    return;
+  first = std::__upper_bound(first, middle, *middle,
+                             __gnu_cxx::__ops::__val_comp_iter(comp));
+  last = std::__lower_bound(middle, last, *(middle - 1),
+                            __gnu_cxx::__ops::__iter_comp_val(comp));
+  Distance len1 = middle - first;
+  Distance len2 = last - middle;
+
+  if (len2 <= buffer_size && len2 <= len1) {
+    merge_backward(first, middle, last, buffer, comp);
+    return;
+  }
+  if (len1 <= buffer_size) {
+    merge_forward(first, middle, last, buffer, comp);
+    return;
+  }
+  if (len1 + len2 == 2) {
+    std::iter_swap(first, middle);
+    return;
+  }
+
+  RandomAccessIterator cut1, cut2;
+  if (len1 > len2) {
+    cut1 = first + len1 / 2;
+    cut2 = std::__lower_bound(middle, last, *cut1,
+                              __gnu_cxx::__ops::__iter_comp_val(comp));
+  } else {
+    cut2 = middle + len2 / 2;
+    cut1 = std::__upper_bound(first, middle, *cut2,
+                              __gnu_cxx::__ops::__val_comp_iter(comp));
+  }
+  RandomAccessIterator new_middle = std::rotate(cut1, middle, cut2);
+  merge_adaptive(first, cut1, new_middle, buffer, buffer_size, comp);
+  merge_adaptive(new_middle, cut2, last, buffer, buffer_size, comp);
+}
+
+/* Merges the sorted ranges [first, middle) and [middle, last) using at
+   most scratch_bytes of scratch memory. */
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+merge_adaptive(
+  RandomAccessIterator first,
+  RandomAccessIterator middle,
+  RandomAccessIterator last,
+  Compare comp,
+  size_t scratch_bytes = incremental_scratch_bytes
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  if (first == middle || middle == last || !comp(middle, middle - 1))
+    return;
+  Distance buffer_size = std::min(Distance(scratch_bytes / sizeof(T)),
+                                  std::min(middle - first, last - middle));
+  std::vector<T> buffer(buffer_size);
+  merge_adaptive(first, middle, last, buffer.data(), buffer_size, comp);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+incremental_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator middle,
+  RandomAccessIterator last,
+  Compare comp,
+  size_t scratch_bytes = incremental_scratch_bytes
+){
+  if (last - middle > 1)
+    introsort(middle, last, comp);
+  merge_adaptive(first, middle, last, comp, scratch_bytes);
+}
+
+/* Sorts the batch with the dispatching introsort of intsort.h and
+   merges with the default scratch memory. */
+template <
+  typename RandomAccessIterator>
+void
+incremental_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator middle,
+  RandomAccessIterator last
+){
+  if (last - middle > 1)
+    introsort(middle, last);
+  merge_adaptive(first, middle, last, __gnu_cxx::__ops::__iter_less_iter());
+}
@@ -0,0 +1,136 @@
+/*
+
+Defines introselect, the introspective selection algorithm: it
+rearranges [first, last) so that *nth is the element that would be
+there if the range were sorted, no element of [first, nth) is greater
+than it, and no element of (nth, last) is less.  Like introsort_loop it
+partitions with a choice of partition kernel and pivot selector, but
+goes on only into the part that contains nth, so it takes linear time
+on average.  When the depth limit runs out, depth_multiplier times
+log N partitions as in introsort_traits, it finishes with heap
+selection, which bounds the worst case by O(N log N).
+
+Also defines introselect_partial_sort, which puts the k = middle - first
+smallest elements of [first, last) in order in [first, middle) by
+selecting the k-th one with introselect and then sorting only the
+prefix with introsort, in O(N + k log k) time on average, compared
+with O(N log k) for the heap-based partial_sort.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+
+#include "intsort.h"
+
+template <
+  typename RandomAccessIterator,
+  typename Size,
+  typename Compare,
+  typename Partition,
+  typename Pivot>
+void
+introselect_loop(
+  RandomAccessIterator first,
+  RandomAccessIterator nth,
+  RandomAccessIterator last,
+  Size depth_limit,
+  Compare comp,
+  Partition partition,
+  Pivot pivot
+){
+  while (last - first > 3) {
+    if (depth_limit == 0) {
+      std::__heap_select(first, nth + 1, last, comp);
+      std::iter_swap(first, nth);
+      return;
+    }
+    --depth_limit;
+    pivot(first, last, comp);
+    RandomAccessIterator cut = partition(first + 1, last, first, comp);
+    if (nth < cut)
+      last = cut;
+    else
+      first = cut;
+  }
+  std::__insertion_sort(first, last, comp);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare,
+  typename Partition,
+  typename Pivot>
+inline
+void
+introselect(
+  RandomAccessIterator first,
+  RandomAccessIterator nth,
+  RandomAccessIterator last,
+  Compare comp,
+  Partition partition,
+  Pivot pivot
+){
+    if (first == last || nth == last)
+      return;
+    typedef iterator_introsort_traits<RandomAccessIterator> traits;
+    introselect_loop(first, nth, last, __lg(last - first) * traits::depth_multiplier,
+                     comp, partition, pivot);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+introselect(
+  RandomAccessIterator first,
+  RandomAccessIterator nth,
+  RandomAccessIterator last,
+  Compare comp
+){
+    introselect(first, nth, last, comp, hoare_partition(), introsort_pivot());
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+void
+introselect(
+  RandomAccessIterator first,
+  RandomAccessIterator nth,
+  RandomAccessIterator last
+){
+    introselect(first, nth, last, __gnu_cxx::__ops::__iter_less_iter());
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+introselect_partial_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator middle,
+  RandomAccessIterator last,
+  Compare comp
+){
+    if (first == middle)
+      return;
+    introselect(first, middle - 1, last, comp);
+    if (middle - first > 2)
+      introsort(first, middle - 1, comp);
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+void
+introselect_partial_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator middle,
+  RandomAccessIterator last
+){
+    introselect_partial_sort(first, middle, last, __gnu_cxx::__ops::__iter_less_iter());
+}
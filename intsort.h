@@ -7,7 +7,11 @@ fast) but which is capable of detecting when partitioning is tending
 toward quadratic behavior. By switching to heapsort in those
 situations, introsort achieves the same O(N log N) time bound as
 heapsort but is almost always faster than just using heapsort in the
-first place.
+first place.  The heapsort is the bottom_up_heapsort of heapsort.h.
+
+The partitioning, the heapsort fallback and the final insertion sort
+of every introsort here run in cost_phase_scopes (see costphase.h), so
+that their counts and times can be reported separately.
 
 */
 
@@ -27,8 +31,15 @@ first place.
 #pragma once
 
 #include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <type_traits>
 
-#include "recorder.h"
+#include "costphase.h"
+#include "heapsort.h"
+#include "radixsort.h"
+#include "simdsort.h"
+#include "tuning.h"
 
 #define __stl_threshold 16
 
@@ -50,7 +61,373 @@ unguarded_partition_pivot(_RandomAccessIterator __first,
   return std::__unguarded_partition(__first + 1, __last, *__first);
 }
 //*/
+
+/*
+introsort_traits<T> supplies the tuning constants of introsort for
+value type T: threshold, the length of the ranges that introsort_loop
+leaves to the final insertion sort, depth_multiplier, the factor by
+which __lg(N) is multiplied to give the depth limit, and fallback, the
+heap policy of heapsort.h that sorts a range when the depth limit runs
+out, bottom_up_heap unless specialized.  Trivially copyable values of
+up to a cache line are cheap to move, so insertion sort stays
+profitable on longer ranges; larger records are expensive to move, so
+it pays only on short ones; everything else keeps __stl_threshold.
+The two thresholds come from tuning.h.
+Specialize introsort_traits to tune a particular type, or sort with
+tuned_introsort and fixed_introsort_traits to try other constants.
+*/
+template <
+  typename T>
+struct introsort_traits {
+  static constexpr ptrdiff_t threshold =
+    !std::is_trivially_copyable<T>::value ? __stl_threshold
+    : sizeof(T) <= 64 ? INTROSORT_THRESHOLD
+    : INTROSORT_LARGE_THRESHOLD;
+  static constexpr int depth_multiplier = 2;
+  typedef bottom_up_heap fallback;
+};
+
+template <
+  ptrdiff_t Threshold,
+  int DepthMultiplier = 2,
+  typename Fallback = bottom_up_heap>
+struct fixed_introsort_traits {
+  static constexpr ptrdiff_t threshold = Threshold;
+  static constexpr int depth_multiplier = DepthMultiplier;
+  typedef Fallback fallback;
+};
+
+template <
+  typename RandomAccessIterator>
+using iterator_introsort_traits =
+  introsort_traits<typename std::iterator_traits<RandomAccessIterator>::value_type>;
+
+/*
+Insertion sort of a range whose first threshold elements include its
+smallest one, as they do after introsort_loop with the same threshold:
+only the first threshold elements need the guarded insertion sort.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+final_insertion_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  ptrdiff_t threshold
+){
+  cost_phase_scope scope(insertion_phase);
+  if (last - first > threshold) {
+    std::__insertion_sort(first, first + threshold, comp);
+    std::__unguarded_insertion_sort(first + threshold, last, comp);
+  } else {
+    std::__insertion_sort(first, last, comp);
+  }
+}
+
+/* The heapsort that introsort_loop and its variants fall back on when
+   the depth limit runs out: the fallback of Traits, or of the
+   introsort_traits of the value type. */
+template <
+  typename Traits,
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+fallback_heapsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  cost_phase_scope scope(heapsort_phase);
+  typename Traits::fallback()(first, last, comp);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+fallback_heapsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  fallback_heapsort<iterator_introsort_traits<RandomAccessIterator> >(first, last, comp);
+}
+
+/*
+Partition kernels for introsort_loop.  A kernel partitions [first, last)
+about the value at pivot, an iterator to an element just before first,
+and returns cut such that no element of [first, cut) is greater than
+the pivot and no element of [cut, last) is less than it.  The range is
+known to contain an element not less than the pivot, which the
+unguarded scans use as a sentinel.
+*/
+
+/* The Hoare partition used by std::sort. */
+struct hoare_partition {
+  template <
+    typename RandomAccessIterator,
+    typename Compare>
+  RandomAccessIterator
+  operator()(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    RandomAccessIterator pivot,
+    Compare comp
+  ) const {
+    return std::__unguarded_partition(first, last, pivot, comp);
+  }
+};
+
+/*
+Block partition after Edelkamp and Weiss, ``BlockQuicksort: How Branch
+Mispredictions don't affect Quicksort''.  Blocks of block_size elements
+are scanned from both ends and the offsets of misplaced elements are
+recorded without a conditional branch; the misplaced elements are then
+swapped in bulk.  Like the Hoare partition, elements equal to the pivot
+count as misplaced on both sides, so runs of equal keys are split
+evenly.  The fewer than 2 * block_size elements left in the middle,
+including any not yet swapped, are finished by the Hoare partition.
+*/
+struct block_partition {
+  enum { block_size = 64 };
+
+  template <
+    typename RandomAccessIterator,
+    typename Compare>
+  RandomAccessIterator
+  operator()(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    RandomAccessIterator pivot,
+    Compare comp
+  ) const {
+    unsigned char offsets_first[block_size];
+    unsigned char offsets_last[block_size];
+    int count_first = 0, count_last = 0;
+    int start_first = 0, start_last = 0;
+
+    while (last - first >= 2 * block_size) {
+      if (count_first == 0) {
+        start_first = 0;
+        for (int i = 0; i < block_size; ++i) {
+          offsets_first[count_first] = i;
+          count_first += !comp(first + i, pivot);
+        }
+      }
+      if (count_last == 0) {
+        start_last = 0;
+        for (int i = 0; i < block_size; ++i) {
+          offsets_last[count_last] = i;
+          count_last += !comp(pivot, last - (i + 1));
+        }
+      }
+      int n = std::min(count_first, count_last);
+      for (int i = 0; i < n; ++i)
+        std::iter_swap(first + offsets_first[start_first + i],
+                       last - (offsets_last[start_last + i] + 1));
+      count_first -= n;
+      count_last -= n;
+      start_first += n;
+      start_last += n;
+      if (count_first == 0)
+        first += block_size;
+      if (count_last == 0)
+        last -= block_size;
+    }
+    return std::__unguarded_partition(first, last, pivot, comp);
+  }
+};
+
+/*
+Pivot selectors for introsort_loop.  A selector moves the pivot it
+chooses from [first, last) to first, leaving at least one element not
+greater and one not less than the pivot in [first + 1, last) for the
+partition kernels to use as sentinels.  Each one picks the median, or
+a pseudo-median, of at least three elements.
+*/
+
+/* Returns the median of *a, *b and *c. */
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+RandomAccessIterator
+median_of_3(
+  RandomAccessIterator a,
+  RandomAccessIterator b,
+  RandomAccessIterator c,
+  Compare comp
+){
+  if (comp(a, b)) {
+    if (comp(b, c))
+      return b;
+    return comp(a, c) ? c : a;
+  }
+  if (comp(a, c))
+    return a;
+  return comp(b, c) ? c : b;
+}
+
+/*
+Returns Tukey's pseudo-median of the 3^level elements first,
+first + step, first + 2 * step, ...: the median of three pseudo-medians
+of 3^(level-1) elements, one of each consecutive third.  It takes
+(3^level - 1) / 2 medians of three.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Distance,
+  typename Compare>
+RandomAccessIterator
+pseudo_median(
+  RandomAccessIterator first,
+  Distance step,
+  int level,
+  Compare comp
+){
+  if (level == 0)
+    return first;
+  Distance third = step;
+  for (int i = 1; i < level; ++i)
+    third = third * 3;
+  return median_of_3(pseudo_median(first, step, level - 1, comp),
+                     pseudo_median(first + third, step, level - 1, comp),
+                     pseudo_median(first + third * 2, step, level - 1, comp),
+                     comp);
+}
+
+/* The median of the second, middle and last elements, exactly as in
+   std::__unguarded_partition_pivot. */
+struct median_of_3_pivot {
+  template <
+    typename RandomAccessIterator,
+    typename Compare>
+  void
+  operator()(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    Compare comp
+  ) const {
+    RandomAccessIterator mid = first + (last - first) / 2;
+    std::__move_median_to_first(first, first + 1, mid, last - 1, comp);
+  }
+};
+
+/* Tukey's ninther: the median of the medians of three groups of three
+   elements spread evenly over the range, or the median of three if the
+   range is too short for that. */
+struct ninther_pivot {
+  template <
+    typename RandomAccessIterator,
+    typename Compare>
+  void
+  operator()(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    Compare comp
+  ) const {
+    if (last - first < 9)
+      median_of_3_pivot()(first, last, comp);
+    else
+      std::iter_swap(first, pseudo_median(first, (last - first) / 9, 2, comp));
+  }
+};
+
+/*
+The pseudo-median of a sample of 3^k elements spread evenly over the
+range, with 3^k the largest power of three not greater than the square
+root of the range's length, but at least 9, and the median of three for
+ranges of fewer than 9 elements.  The sample grows with the range, so
+the split of a long range stays close to even.
+*/
+struct sampled_pivot {
+  template <
+    typename RandomAccessIterator,
+    typename Compare>
+  void
+  operator()(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    Compare comp
+  ) const {
+    typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+    Distance n = last - first;
+    if (n < Distance(9)) {
+      median_of_3_pivot()(first, last, comp);
+      return;
+    }
+    Distance sample = 9;
+    int level = 2;
+    while (sample * sample * 9 <= n) {
+      sample = sample * 3;
+      ++level;
+    }
+    std::iter_swap(first, pseudo_median(first, n / sample, level, comp));
+  }
+};
+
+/*
+Median of three for ranges of up to ninther_threshold elements, the
+ninther up to sample_threshold elements, and the sampled pseudo-median
+for longer ranges.
+*/
+struct adaptive_pivot {
+  enum {
+    ninther_threshold = 128,
+    sample_threshold = 1 << 14
+  };
+
+  template <
+    typename RandomAccessIterator,
+    typename Compare>
+  void
+  operator()(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    Compare comp
+  ) const {
+    if (last - first <= ninther_threshold)
+      median_of_3_pivot()(first, last, comp);
+    else if (last - first <= sample_threshold)
+      ninther_pivot()(first, last, comp);
+    else
+      sampled_pivot()(first, last, comp);
+  }
+};
+
+/* The pivot selector of the default introsort_loop, set in tuning.h. */
+typedef INTROSORT_PIVOT introsort_pivot;
+
+template <
+  typename Traits,
+  typename RandomAccessIterator,
+  typename Size,
+  typename Compare>
+void
+tuned_introsort_loop(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Size depth_limit,
+  Compare comp
+){
+  while (last - first > Traits::threshold) {
+    if (depth_limit == 0) {
+      fallback_heapsort<Traits>(first, last, comp);
+      return;
+    }
+    introsort_pivot()(first, last, comp);
+    RandomAccessIterator cut = std::__unguarded_partition(first + 1, last, first, comp);
+    tuned_introsort_loop<Traits>(cut, last, depth_limit-1, comp);
+    last = cut;
+  }
+}
+
 template <class RandomAccessIterator, class Size, class Compare>
+inline
 void
 introsort_loop(
   RandomAccessIterator first,
@@ -58,17 +435,621 @@ introsort_loop(
   Size depth_limit,
   Compare comp
 ){
-  while (last - first > __stl_threshold) {
+  tuned_introsort_loop<iterator_introsort_traits<RandomAccessIterator> >(
+    first, last, depth_limit, comp);
+}
+
+/*
+introsort_loop with a choice of partition kernel and pivot selector.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Size,
+  typename Compare,
+  typename Partition,
+  typename Pivot>
+void
+introsort_loop(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Size depth_limit,
+  Compare comp,
+  Partition partition,
+  Pivot pivot
+){
+  while (last - first > iterator_introsort_traits<RandomAccessIterator>::threshold) {
     if (depth_limit == 0) {
-      partial_sort(first, last, last, comp);
+      fallback_heapsort(first, last, comp);
       return;
     }
-    RandomAccessIterator cut = std::__unguarded_partition_pivot(first, last, comp);
-    introsort_loop(cut, last, depth_limit-1, comp);
+    pivot(first, last, comp);
+    RandomAccessIterator cut = partition(first + 1, last, first, comp);
+    introsort_loop(cut, last, depth_limit-1, comp, partition, pivot);
     last = cut;
   }
 }
 
+/*
+introsort_loop without recursion.  The part of each partition that is
+not sorted next is pushed on a stack of fixed size together with its
+own depth limit: as in the recursive introsort_loop, the right part
+of a partition gets depth_limit - 1 and the left part keeps
+depth_limit, so every range is partitioned, or handed to heapsort,
+with the same depth limit as there.  The larger part is always
+the one pushed, so each entry on the stack is at least twice as long
+as the entry above it, and the stack never holds more than
+__lg(last - first) entries.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Size,
+  typename Compare,
+  typename Partition,
+  typename Pivot>
+void
+iterative_introsort_loop(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Size depth_limit,
+  Compare comp,
+  Partition partition,
+  Pivot pivot
+){
+  struct range {
+    RandomAccessIterator first;
+    RandomAccessIterator last;
+    Size depth_limit;
+  };
+
+  enum { stack_size = 8 * sizeof(size_t) };
+  range stack[stack_size];
+  int top = 0;
+
+  for (;;) {
+    while (last - first > iterator_introsort_traits<RandomAccessIterator>::threshold) {
+      if (depth_limit == 0) {
+        fallback_heapsort(first, last, comp);
+        break;
+      }
+      pivot(first, last, comp);
+      RandomAccessIterator cut = partition(first + 1, last, first, comp);
+      assert(top < stack_size);
+      if (cut - first < last - cut) {
+        stack[top].first = cut;
+        stack[top].last = last;
+        stack[top].depth_limit = depth_limit;
+        --stack[top].depth_limit;
+        last = cut;
+      } else {
+        stack[top].first = first;
+        stack[top].last = cut;
+        stack[top].depth_limit = depth_limit;
+        first = cut;
+        --depth_limit;
+      }
+      ++top;
+    }
+    if (top == 0)
+      return;
+    --top;
+    first = stack[top].first;
+    last = stack[top].last;
+    depth_limit = stack[top].depth_limit;
+  }
+}
+
+/*
+Moves the elements of [first, last) that are not greater than the value
+at pivot to the front and returns the end of them.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+RandomAccessIterator
+partition_equal(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  RandomAccessIterator pivot,
+  Compare comp
+){
+  for (;;) {
+    while (first != last && !comp(pivot, first))
+      ++first;
+    if (first == last)
+      return first;
+    --last;
+    while (first != last && comp(pivot, last))
+      --last;
+    if (first == last)
+      return first;
+    std::iter_swap(first, last);
+    ++first;
+  }
+}
+
+/*
+introsort_loop with three-way partitioning for inputs with many equal
+keys.  After each partition the pivot is swapped to the end of the
+left part, which is its final position, so every range except the
+leftmost one is preceded by the pivot that split it off, an element
+not greater than any element of the range.  When that predecessor is
+not less than the new pivot, the new pivot is the smallest element of
+the range, so the elements equal to it are moved to the front with
+partition_equal and skipped.  A range of k distinct keys is therefore
+disposed of after at most k such steps, and sorting takes O(N k) time
+when k is small.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Size,
+  typename Compare,
+  typename Partition,
+  typename Pivot>
+void
+three_way_introsort_loop(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Size depth_limit,
+  Compare comp,
+  Partition partition,
+  Pivot pivot,
+  bool leftmost
+){
+  while (last - first > iterator_introsort_traits<RandomAccessIterator>::threshold) {
+    if (depth_limit == 0) {
+      fallback_heapsort(first, last, comp);
+      return;
+    }
+    pivot(first, last, comp);
+    if (!leftmost && !comp(first - 1, first)) {
+      first = partition_equal(first + 1, last, first, comp);
+      continue;
+    }
+    RandomAccessIterator cut = partition(first + 1, last, first, comp);
+    std::iter_swap(first, cut - 1);
+    three_way_introsort_loop(cut, last, depth_limit-1, comp, partition, pivot, false);
+    last = cut - 1;
+  }
+}
+
+/* Sorts *a, ..., *e by an optimal network of nine comparators. */
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+sort_five(
+  RandomAccessIterator a,
+  RandomAccessIterator b,
+  RandomAccessIterator c,
+  RandomAccessIterator d,
+  RandomAccessIterator e,
+  Compare comp
+){
+  RandomAccessIterator x[5] = {a, b, c, d, e};
+  const int pairs[9][2] = {{0,3}, {1,4}, {0,2}, {1,3}, {0,1},
+                           {2,4}, {1,2}, {3,4}, {2,3}};
+  for (int i = 0; i < 9; ++i)
+    if (comp(x[pairs[i][1]], x[pairs[i][0]]))
+      std::iter_swap(x[pairs[i][0]], x[pairs[i][1]]);
+}
+
+/*
+Sorts five elements spaced N/6 apart and returns them in s, smallest
+first, to give the multi-pivot partitions pivots near the quantiles.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+sample_five(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  RandomAccessIterator* s,
+  Compare comp
+){
+  typename std::iterator_traits<RandomAccessIterator>::difference_type step = (last - first) / 6;
+  for (int k = 0; k < 5; ++k)
+    s[k] = first + step * (k + 1);
+  sort_five(s[0], s[1], s[2], s[3], s[4], comp);
+}
+
+/*
+Dual-pivot introsort, after Yaroslavskiy's dual-pivot quicksort.  The
+second and fourth of five sampled elements become pivots p <= q, at
+first and last - 1, and one pass divides the range into elements less
+than p, elements from p to q and elements greater than q.  Every pass
+moves each element at most once per pivot, and the three parts are
+about a third of the range each, so the range is scanned about
+log3 N rather than log2 N times, which saves memory traffic.  When
+the pivots are equal the middle part holds only elements equal to
+them and is not sorted further.
+
+Unlike the other loops in this file, it decrements the depth limit on
+every level, whichever part it continues with, so that a range is
+never partitioned more than depth_limit times before heapsort takes
+over.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Size,
+  typename Compare>
+void
+dual_pivot_introsort_loop(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Size depth_limit,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  auto comp_value = __gnu_cxx::__ops::__iter_comp_val(comp);
+  auto comp_value_iter = __gnu_cxx::__ops::__val_comp_iter(comp);
+
+  while (last - first > iterator_introsort_traits<RandomAccessIterator>::threshold) {
+    if (depth_limit == 0) {
+      fallback_heapsort(first, last, comp);
+      return;
+    }
+    --depth_limit;
+
+    RandomAccessIterator s[5];
+    sample_five(first, last, s, comp);
+    std::iter_swap(s[1], first);
+    std::iter_swap(s[3], last - 1);
+    T p = *first, q = *(last - 1);
+
+    /* [first + 1, less) < p <= [less, k) <= q < (greater, last - 1) */
+    RandomAccessIterator less = first + 1, greater = last - 2;
+    while (comp_value(less, p))
+      ++less;
+    while (comp_value_iter(q, greater))
+      --greater;
+    for (RandomAccessIterator k = less; !(greater < k); ++k) {
+      if (comp_value(k, p)) {
+        T value = std::move(*k);
+        *k = std::move(*less);
+        *less = std::move(value);
+        ++less;
+      } else if (comp_value_iter(q, k)) {
+        while (comp_value_iter(q, greater))
+          if (--greater < k)
+            goto partitioned;
+        T value = std::move(*k);
+        if (comp_value(greater, p)) {
+          *k = std::move(*less);
+          *less = std::move(*greater);
+          ++less;
+        } else {
+          *k = std::move(*greater);
+        }
+        *greater = std::move(value);
+        --greater;
+      }
+    }
+  partitioned:
+    --less;
+    ++greater;
+    *first = std::move(*less);
+    *less = std::move(p);
+    *(last - 1) = std::move(*greater);
+    *greater = std::move(q);
+
+    dual_pivot_introsort_loop(first, less, depth_limit, comp);
+    if (comp_value_iter(p, greater))
+      dual_pivot_introsort_loop(less + 1, greater, depth_limit, comp);
+    first = greater + 1;
+  }
+}
+
+/*
+Three-pivot introsort, after Kushagra, Lopez-Ortiz, Qiao and Munro,
+``Multi-Pivot Quicksort: Theory and Experiments''.  The second, third
+and fourth of five sampled elements become pivots p <= q <= r, at
+first, first + 1 and last - 1.  Two scans move inward from both ends,
+the left one keeping the elements less than p apart from those from
+p to q, and the right one the elements greater than r apart from those
+from q to r, so one pass produces four parts of about a quarter of
+the range each, with fewer cache misses per element than either the
+single- or the dual-pivot partition.  The depth limit is counted as in
+dual_pivot_introsort_loop.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Size,
+  typename Compare>
+void
+three_pivot_introsort_loop(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Size depth_limit,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  auto comp_value = __gnu_cxx::__ops::__iter_comp_val(comp);
+  auto comp_value_iter = __gnu_cxx::__ops::__val_comp_iter(comp);
+
+  while (last - first > iterator_introsort_traits<RandomAccessIterator>::threshold) {
+    if (depth_limit == 0) {
+      fallback_heapsort(first, last, comp);
+      return;
+    }
+    --depth_limit;
+
+    RandomAccessIterator s[5];
+    sample_five(first, last, s, comp);
+    std::iter_swap(s[1], first);
+    std::iter_swap(s[2], first + 1);
+    std::iter_swap(s[3], last - 1);
+    T p = *first, q = *(first + 1), r = *(last - 1);
+
+    /* [first + 2, a) < p <= [a, b) <= q <= (c, d] <= r < (d, last - 1) */
+    RandomAccessIterator a = first + 2, b = a, c = last - 2, d = c;
+    while (!(c < b)) {
+      while (!(c < b) && comp_value(b, q)) {
+        if (comp_value(b, p)) {
+          std::iter_swap(a, b);
+          ++a;
+        }
+        ++b;
+      }
+      while (!(c < b) && comp_value_iter(q, c)) {
+        if (comp_value_iter(r, c)) {
+          std::iter_swap(c, d);
+          --d;
+        }
+        --c;
+      }
+      if (!(c < b)) {
+        /* *b >= q >= *c: *c goes left, to [first + 2, a) if it is less
+           than p, and *b right, to (d, last - 1) if it is greater than
+           r. */
+        bool greater = comp_value_iter(r, b);
+        T value = std::move(*b);
+        if (comp_value(c, p)) {
+          *b = std::move(*a);
+          *a = std::move(*c);
+          ++a;
+        } else {
+          *b = std::move(*c);
+        }
+        if (greater) {
+          *c = std::move(*d);
+          *d = std::move(value);
+          --d;
+        } else {
+          *c = std::move(value);
+        }
+        ++b;
+        --c;
+      }
+    }
+    --a;
+    --b;
+    ++d;
+    *(first + 1) = std::move(*a);
+    *a = std::move(*b);
+    *b = std::move(q);
+    --a;
+    *first = std::move(*a);
+    *a = std::move(p);
+    *(last - 1) = std::move(*d);
+    *d = std::move(r);
+
+    three_pivot_introsort_loop(first, a, depth_limit, comp);
+    three_pivot_introsort_loop(a + 1, b, depth_limit, comp);
+    three_pivot_introsort_loop(b + 1, d, depth_limit, comp);
+    first = d + 1;
+  }
+}
+
+/*
+Pattern-defeating introsort, after Peters, ``Pattern-defeating
+Quicksort''.  It differs from three_way_introsort in four ways:
+
+  - the partition, partition_right, puts the elements equal to the
+    pivot on the right and reports whether it found the range already
+    partitioned, without a swap;
+  - after a well-balanced partition of an already partitioned range,
+    both parts are given to partial_insertion_sort, which gives up
+    after moving partial_insertion_limit elements; if both come out
+    sorted, the range is done;
+  - after a partition that leaves fewer than 1/8 of the elements on
+    one side, a few elements of each part are swapped to break up the
+    pattern that produced it, and once log2(N) such partitions have
+    occurred the range is heapsorted, which keeps the O(N log N)
+    worst case;
+  - adaptive_introsort first reverses the range if it is strictly
+    decreasing.
+
+Like introsort_loop, adaptive_introsort_loop leaves the ranges shorter
+than adaptive_insertion_threshold to one final_insertion_sort, which
+is skipped when it returns false because it left none.
+
+Sorted, reversed and nearly sorted inputs take linear time.
+*/
+
+const int partial_insertion_limit = 8;
+
+const int adaptive_insertion_threshold = 24;
+
+/* Insertion sort of [first, last) that gives up, returning false, once
+   it has moved more than partial_insertion_limit elements. */
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+bool
+partial_insertion_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+
+  if (first == last)
+    return true;
+  Distance moved = 0;
+  auto comp_value = __gnu_cxx::__ops::__val_comp_iter(comp);
+  for (RandomAccessIterator i = first + 1; i != last; ++i) {
+    RandomAccessIterator hole = i;
+    RandomAccessIterator prev = i - 1;
+    if (comp(hole, prev)) {
+      T value = std::move(*hole);
+      do {
+        *hole = std::move(*prev);
+        --hole;
+      } while (hole != first && comp_value(value, --prev));
+      *hole = std::move(value);
+      moved = moved + (i - hole);
+    }
+    if (Distance(partial_insertion_limit) < moved)
+      return false;
+  }
+  return true;
+}
+
+/*
+Partitions [first + 1, last) about the pivot at first into elements
+less than the pivot and elements not less than it, moves the pivot
+between the two parts and returns its position, together with whether
+the range was already partitioned.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+std::pair<RandomAccessIterator, bool>
+partition_right(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  auto comp_value = __gnu_cxx::__ops::__iter_comp_val(comp);
+  T pivot = std::move(*first);
+  RandomAccessIterator left = first;
+  RandomAccessIterator right = last;
+
+  while (comp_value(++left, pivot))
+    ;
+  if (left - 1 == first)
+    while (left < right && !comp_value(--right, pivot))
+      ;
+  else
+    while (!comp_value(--right, pivot))
+      ;
+
+  bool already_partitioned = !(left < right);
+  while (left < right) {
+    std::iter_swap(left, right);
+    while (comp_value(++left, pivot))
+      ;
+    while (!comp_value(--right, pivot))
+      ;
+  }
+
+  RandomAccessIterator pivot_position = left - 1;
+  *first = std::move(*pivot_position);
+  *pivot_position = std::move(pivot);
+  return std::make_pair(pivot_position, already_partitioned);
+}
+
+/* Swaps a few elements of a range left by a badly unbalanced
+   partition, so that the next pivot is drawn from a different
+   pattern. */
+template <
+  typename RandomAccessIterator>
+void
+break_patterns(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+
+  Distance n = last - first;
+  if (n < Distance(adaptive_insertion_threshold))
+    return;
+  std::iter_swap(first, first + n / 4);
+  std::iter_swap(last - 1, last - n / 4);
+  if (Distance(128) < n) {
+    std::iter_swap(first + 1, first + (n / 4 + 1));
+    std::iter_swap(first + 2, first + (n / 4 + 2));
+    std::iter_swap(last - 2, last - (n / 4 + 1));
+    std::iter_swap(last - 3, last - (n / 4 + 2));
+  }
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare,
+  typename Pivot>
+bool
+adaptive_introsort_loop(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  int bad_allowed,
+  Compare comp,
+  Pivot pivot,
+  bool leftmost
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+
+  bool unsorted = false;
+  for (;;) {
+    Distance n = last - first;
+    if (n < Distance(adaptive_insertion_threshold))
+      return unsorted || n > 1;
+
+    pivot(first, last, comp);
+    if (!leftmost && !comp(first - 1, first)) {
+      first = partition_equal(first + 1, last, first, comp);
+      continue;
+    }
+
+    std::pair<RandomAccessIterator, bool> part = partition_right(first, last, comp);
+    RandomAccessIterator cut = part.first;
+    Distance left_size = cut - first;
+    Distance right_size = last - (cut + 1);
+
+    if (left_size < n / 8 || right_size < n / 8) {
+      if (--bad_allowed == 0) {
+        fallback_heapsort(first, last, comp);
+        return unsorted;
+      }
+      break_patterns(first, cut);
+      break_patterns(cut + 1, last);
+    } else if (part.second
+               && partial_insertion_sort(first, cut, comp)
+               && partial_insertion_sort(cut + 1, last, comp)) {
+      return unsorted;
+    }
+
+    if (adaptive_introsort_loop(first, cut, bad_allowed, comp, pivot, leftmost))
+      unsorted = true;
+    first = cut + 1;
+    leftmost = false;
+  }
+}
+
+template <
+  typename Traits,
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+tuned_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+    static_assert(Traits::threshold >= 3,
+                  "the median of three needs three distinct elements");
+    cost_phase_scope scope(partition_phase);
+    tuned_introsort_loop<Traits>(first, last, __lg(last - first) * Traits::depth_multiplier, comp);
+    final_insertion_sort(first, last, comp, Traits::threshold);
+}
+
 template <
   typename RandomAccessIterator,
   typename Compare>
@@ -79,13 +1060,202 @@ introsort(
   RandomAccessIterator last,
   Compare comp
 ){
-    introsort_loop(first, last, __lg(last - first) * 2, comp);
-    __final_insertion_sort(first, last, comp);
+    tuned_introsort<iterator_introsort_traits<RandomAccessIterator> >(first, last, comp);
 }
 
+/*
+Without a comparison function, contiguous ranges of int, float and
+double are sorted by the vectorized introsort of simdsort.h when the
+processor supports it, which is faster than radix sorting them; other
+long ranges of types with a radix key are sorted by the radix sort of
+radixsort.h.
+*/
 template <
   typename RandomAccessIterator>
 inline void introsort(RandomAccessIterator first, RandomAccessIterator last)
 {
+    if (simd_introsort(first, last))
+      return;
+    if (radix_introsort(first, last))
+      return;
     introsort(first, last, __gnu_cxx::__ops::__iter_less_iter());
 }
+
+template <
+  typename RandomAccessIterator,
+  typename Compare,
+  typename Partition,
+  typename Pivot>
+inline
+void
+introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  Partition partition,
+  Pivot pivot
+){
+    typedef iterator_introsort_traits<RandomAccessIterator> traits;
+    cost_phase_scope scope(partition_phase);
+    introsort_loop(first, last, __lg(last - first) * traits::depth_multiplier, comp, partition, pivot);
+    final_insertion_sort(first, last, comp, traits::threshold);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare,
+  typename Partition>
+inline
+void
+introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  Partition partition
+){
+    introsort(first, last, comp, partition, median_of_3_pivot());
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare,
+  typename Partition,
+  typename Pivot>
+inline
+void
+three_way_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  Partition partition,
+  Pivot pivot
+){
+    typedef iterator_introsort_traits<RandomAccessIterator> traits;
+    if (last - first < 2)
+      return;
+    cost_phase_scope scope(partition_phase);
+    three_way_introsort_loop(first, last, __lg(last - first) * traits::depth_multiplier, comp, partition, pivot, true);
+    final_insertion_sort(first, last, comp, traits::threshold);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+three_way_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+    three_way_introsort(first, last, comp, hoare_partition(), median_of_3_pivot());
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+dual_pivot_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+    typedef iterator_introsort_traits<RandomAccessIterator> traits;
+    if (last - first < 2)
+      return;
+    cost_phase_scope scope(partition_phase);
+    dual_pivot_introsort_loop(first, last, __lg(last - first) * traits::depth_multiplier, comp);
+    final_insertion_sort(first, last, comp, traits::threshold);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+three_pivot_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+    typedef iterator_introsort_traits<RandomAccessIterator> traits;
+    if (last - first < 2)
+      return;
+    cost_phase_scope scope(partition_phase);
+    three_pivot_introsort_loop(first, last, __lg(last - first) * traits::depth_multiplier, comp);
+    final_insertion_sort(first, last, comp, traits::threshold);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare,
+  typename Pivot>
+void
+adaptive_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  Pivot pivot
+){
+    if (last - first < 2)
+      return;
+    RandomAccessIterator i = first + 1;
+    while (i != last && comp(i, i - 1))
+      ++i;
+    if (i == last) {
+      std::reverse(first, last);
+      return;
+    }
+    cost_phase_scope scope(partition_phase);
+    if (adaptive_introsort_loop(first, last, int(__lg(last - first)), comp, pivot, true))
+      final_insertion_sort(first, last, comp, adaptive_insertion_threshold);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+adaptive_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+    adaptive_introsort(first, last, comp, adaptive_pivot());
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare,
+  typename Partition,
+  typename Pivot>
+inline
+void
+iterative_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  Partition partition,
+  Pivot pivot
+){
+    typedef iterator_introsort_traits<RandomAccessIterator> traits;
+    if (last - first < 2)
+      return;
+    cost_phase_scope scope(partition_phase);
+    iterative_introsort_loop(first, last, __lg(last - first) * traits::depth_multiplier, comp, partition, pivot);
+    final_insertion_sort(first, last, comp, traits::threshold);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+iterative_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+    iterative_introsort(first, last, comp, hoare_partition(), median_of_3_pivot());
+}
@@ -1,13 +1,16 @@
 /*
 Defines class iteration_counter<RandomAccessIterator, T, Reference,
-Distance, DistanceBase>, for use in measuring the
+Distance, Traced>, for use in measuring the
 performance of certain STL generic algorithms.  Objects of this class
 behave like those of type RandomAccessIterator, but the class also
 keeps counts of all iterator operations, using values of type
 Counting.  Type T should be the value type of RandomAccessIterator,
 and Reference should be the reference type of T.  Type Distance should
 be a distance type for RandomAccessIterator, and Counting is the type
-used for the counts.
+used for the counts.  If Traced is true, operator* also records the
+address it dereferences while the thread records an address_trace
+(see cachesim.h); otherwise it has no hook, so the counted runs that
+do not trace pay nothing for it.
 */
 
 /*
@@ -27,6 +30,10 @@ used for the counts.
 
 #include <iostream>
 #include <iterator>
+#include <memory>
+
+#include "cachesim.h"
+#include "shardcount.h"
 
 using std::endl;
 using std::iterator_traits;
@@ -37,64 +44,106 @@ template <
   typename RandomAccessIterator,
   typename T,
   typename Reference,
-  typename Distance>
+  typename Distance,
+  bool Traced = false>
 class iteration_counter : public iterator_traits<RandomAccessIterator> {
-  typedef iteration_counter<RandomAccessIterator, T, Reference, Distance> self;
+  typedef iteration_counter<RandomAccessIterator, T, Reference, Distance, Traced> self;
 
   template <
     typename _RandomAccessIterator,
     typename _T,
     typename _Reference,
-    typename _Distance>
+    typename _Distance,
+    bool _Traced>
   friend
   bool
   operator==(
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y);
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y);
 
   template <
     typename _RandomAccessIterator,
     typename _T,
     typename _Reference,
-    typename _Distance>
+    typename _Distance,
+    bool _Traced>
   friend
   bool
   operator!=(
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y);
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y);
 
   template <
     typename _RandomAccessIterator,
     typename _T,
     typename _Reference,
-    typename _Distance>
+    typename _Distance,
+    bool _Traced>
   friend
   bool
   operator<(
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y);
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y);
+
+  template <
+    typename _RandomAccessIterator,
+    typename _T,
+    typename _Reference,
+    typename _Distance,
+    bool _Traced>
+  friend
+  bool
+  operator<=(
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y);
+
+  template <
+    typename _RandomAccessIterator,
+    typename _T,
+    typename _Reference,
+    typename _Distance,
+    bool _Traced>
+  friend
+  bool
+  operator>=(
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y);
+
+  template <
+    typename _RandomAccessIterator,
+    typename _T,
+    typename _Reference,
+    typename _Distance,
+    bool _Traced>
+  friend
+  bool
+  operator>(
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y);
 
   template <
     typename _RandomAccessIterator,
     typename _T,
     typename _Reference,
-    typename _Distance>
+    typename _Distance,
+    bool _Traced>
   friend
   self
   operator+(
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y);
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y);
 
   template <
     typename _RandomAccessIterator,
     typename _T,
     typename _Reference,
-    typename _Distance>
+    typename _Distance,
+    bool _Traced>
   friend
   _Distance
   operator-(
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y);
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+    const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y);
 
 
 protected:
@@ -102,13 +151,13 @@ protected:
   ssize_t generation;
 public:
 
-  static ssize_t constructions;
-  static ssize_t assignments;
-  static ssize_t increments;
-  static ssize_t dereferences;
-  static ssize_t bigjumps;
-  static ssize_t comparisons;
-  static ssize_t max_generation;
+  static sharded_count constructions;
+  static sharded_count assignments;
+  static sharded_count increments;
+  static sharded_count dereferences;
+  static sharded_count bigjumps;
+  static sharded_count comparisons;
+  static sharded_max max_generation;
 
   static
   void
@@ -131,6 +180,18 @@ public:
            comparisons + max_generation;
   }
 
+  /* The operations counted in phase; the maximum generation, which is
+     not an operation, is left out. */
+  static
+  ssize_t
+  total(
+    int phase
+  ){
+    return constructions.in_phase(phase) + assignments.in_phase(phase) +
+           increments.in_phase(phase) + dereferences.in_phase(phase) +
+           bigjumps.in_phase(phase) + comparisons.in_phase(phase);
+  }
+
   static void report(ostream& o) {
     o << "Iterator stats: \n"
       << "  Constructions:  " << constructions << "\n"
@@ -160,9 +221,7 @@ public:
     current = c.current;
     generation = c.generation + 1;
     ++constructions;
-    if (generation > max_generation) {
-      max_generation = generation;
-    }
+    max_generation.raise(generation);
   }
 
   RandomAccessIterator
@@ -175,6 +234,8 @@ public:
   operator*(
   ) const {
     ++dereferences;
+    if constexpr (Traced)
+      trace_dereference(std::addressof(*current));
     return *current;
   }
 
@@ -330,13 +391,14 @@ template <
   typename _RandomAccessIterator,
   typename _T,
   typename _Reference,
-  typename _Distance>
+  typename _Distance,
+  bool _Traced>
 bool
 operator==(
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y
 ){
-  ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>::comparisons;
+  ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>::comparisons;
   return x.current == y.current;
 }
 
@@ -344,11 +406,12 @@ template <
   typename _RandomAccessIterator,
   typename _T,
   typename _Reference,
-  typename _Distance>
+  typename _Distance,
+  bool _Traced>
 bool
 operator!=(
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y)
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y)
 {
   return !(x == y);
 }
@@ -357,13 +420,14 @@ template <
   typename _RandomAccessIterator,
   typename _T,
   typename _Reference,
-  typename _Distance>
+  typename _Distance,
+  bool _Traced>
 bool
 operator<(
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y)
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y)
 {
-   ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>::comparisons;
+   ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>::comparisons;
    return x.current < y.current;
 }
 
@@ -371,13 +435,14 @@ template <
   typename _RandomAccessIterator,
   typename _T,
   typename _Reference,
-  typename _Distance>
+  typename _Distance,
+  bool _Traced>
 bool
 operator<=(
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y)
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y)
 {
-   ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>::comparisons;
+   ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>::comparisons;
    return x.current <= y.current;
 }
 
@@ -385,13 +450,14 @@ template <
   typename _RandomAccessIterator,
   typename _T,
   typename _Reference,
-  typename _Distance>
+  typename _Distance,
+  bool _Traced>
 bool
 operator>=(
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y)
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y)
 {
-   ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>::comparisons;
+   ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>::comparisons;
    return x.current >= y.current;
 }
 
@@ -399,13 +465,14 @@ template <
   typename _RandomAccessIterator,
   typename _T,
   typename _Reference,
-  typename _Distance>
+  typename _Distance,
+  bool _Traced>
 bool
 operator>(
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y)
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y)
 {
-   ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>::comparisons;
+   ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>::comparisons;
    return x.current > y.current;
 }
 
@@ -413,13 +480,14 @@ template <
   typename _RandomAccessIterator,
   typename _T,
   typename _Reference,
-  typename _Distance>
+  typename _Distance,
+  bool _Traced>
 _Distance
 operator-(
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x,
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& y
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x,
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& y
 ){
-  ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>::bigjumps;
+  ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>::bigjumps;
   return _Distance(x.current - y.current);
 }
 
@@ -428,14 +496,15 @@ template <
   typename _RandomAccessIterator,
   typename _T,
   typename _Reference,
-  typename _Distance>
-iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>
+  typename _Distance,
+  bool _Traced>
+iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>
 operator+(
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& n,
-  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>& x
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& n,
+  const iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>& x
 ){
-  ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>::bigjumps;
-  return iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance>(x.current + n.current);
+  ++iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>::bigjumps;
+  return iteration_counter<_RandomAccessIterator, _T, _Reference, _Distance, _Traced>(x.current + n.current);
 }
 
 
@@ -444,47 +513,54 @@ template <
   typename RandomAccessIterator,
   typename T,
   typename Reference,
-  typename Distance>
-ssize_t iteration_counter<RandomAccessIterator, T, Reference, Distance>::constructions = 0;
+  typename Distance,
+  bool Traced>
+sharded_count iteration_counter<RandomAccessIterator, T, Reference, Distance, Traced>::constructions;
 
 template <
   typename RandomAccessIterator,
   typename T,
   typename Reference,
-  typename Distance>
-ssize_t iteration_counter<RandomAccessIterator, T, Reference, Distance>::assignments = 0;
+  typename Distance,
+  bool Traced>
+sharded_count iteration_counter<RandomAccessIterator, T, Reference, Distance, Traced>::assignments;
 
 template <
   typename RandomAccessIterator,
   typename T,
   typename Reference,
-  typename Distance>
-ssize_t iteration_counter<RandomAccessIterator, T, Reference, Distance>::increments = 0;
+  typename Distance,
+  bool Traced>
+sharded_count iteration_counter<RandomAccessIterator, T, Reference, Distance, Traced>::increments;
 
 template <
   typename RandomAccessIterator,
   typename T,
   typename Reference,
-  typename Distance>
-ssize_t iteration_counter<RandomAccessIterator, T, Reference, Distance>::dereferences = 0;
+  typename Distance,
+  bool Traced>
+sharded_count iteration_counter<RandomAccessIterator, T, Reference, Distance, Traced>::dereferences;
 
 template <
   typename RandomAccessIterator,
   typename T,
   typename Reference,
-  typename Distance>
-ssize_t iteration_counter<RandomAccessIterator, T, Reference, Distance>::bigjumps = 0;
+  typename Distance,
+  bool Traced>
+sharded_count iteration_counter<RandomAccessIterator, T, Reference, Distance, Traced>::bigjumps;
 
 template <
   typename RandomAccessIterator,
   typename T,
   typename Reference,
-  typename Distance>
-ssize_t iteration_counter<RandomAccessIterator, T, Reference, Distance>::comparisons = 0;
+  typename Distance,
+  bool Traced>
+sharded_count iteration_counter<RandomAccessIterator, T, Reference, Distance, Traced>::comparisons;
 
 template <
   typename RandomAccessIterator,
   typename T,
   typename Reference,
-  typename Distance>
-ssize_t iteration_counter<RandomAccessIterator, T, Reference, Distance>::max_generation = 0;
+  typename Distance,
+  bool Traced>
+sharded_max iteration_counter<RandomAccessIterator, T, Reference, Distance, Traced>::max_generation;
@@ -0,0 +1,101 @@
+/*
+
+Defines a parallel overload of introsort that takes a task_pool as its
+first argument.  Pivots are chosen by introsort_pivot, the selector
+that tuning.h configures for the serial introsort, so that autotuning
+applies to both.  Each partitioning step keeps the left part and hands
+the right part to the pool as a new task, so idle workers steal the
+largest outstanding partitions.  Every task carries its own depth
+limit and switches to heapsort when it runs out.  Unlike the serial
+introsort_loop, which lowers the limit only for the right part, each
+partitioning step lowers it for both parts, as std::sort does, so the
+parallel sort may fall back to heapsort at a shallower depth on
+adversarial inputs.  Partitions of at most grain elements are
+finished with iterative_introsort_loop, which needs little of the
+worker's stack, and final_insertion_sort.  Each task counts its
+partitioning in partition_phase of the worker that runs it.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "intsort.h"
+#include "taskpool.h"
+#include "tuning.h"
+
+const ptrdiff_t parallel_grain = INTROSORT_PARALLEL_GRAIN;
+
+template <
+  typename RandomAccessIterator,
+  typename Size,
+  typename Compare>
+void
+parallel_introsort_loop(
+  task_pool& pool,
+  std::atomic<ssize_t>& outstanding,
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Size depth_limit,
+  Compare comp,
+  ptrdiff_t grain
+){
+  cost_phase_scope scope(partition_phase);
+  while (last - first > grain) {
+    if (depth_limit == 0) {
+      fallback_heapsort(first, last, comp);
+      return;
+    }
+    --depth_limit;
+    introsort_pivot()(first, last, comp);
+    RandomAccessIterator cut = std::__unguarded_partition(first + 1, last, first, comp);
+    ++outstanding;
+    pool.submit([&pool, &outstanding, cut, last, depth_limit, comp, grain]{
+      parallel_introsort_loop(pool, outstanding, cut, last, depth_limit, comp, grain);
+      --outstanding;
+    });
+    last = cut;
+  }
+  iterative_introsort_loop(first, last, depth_limit, comp,
+                           hoare_partition(), introsort_pivot());
+  final_insertion_sort(first, last, comp,
+                       iterator_introsort_traits<RandomAccessIterator>::threshold);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+introsort(
+  task_pool& pool,
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  ptrdiff_t grain = parallel_grain
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+  Distance n = last - first;
+  if (n < 2)
+    return;
+  typedef iterator_introsort_traits<RandomAccessIterator> traits;
+  if (grain < traits::threshold)
+    grain = traits::threshold;
+  std::atomic<ssize_t> outstanding(0);
+  parallel_introsort_loop(pool, outstanding, first, last,
+                          __lg(n) * traits::depth_multiplier, comp, grain);
+  pool.wait(outstanding);
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+void
+introsort(
+  task_pool& pool,
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  introsort(pool, first, last, __gnu_cxx::__ops::__iter_less_iter());
+}
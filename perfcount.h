@@ -0,0 +1,203 @@
+/*
+
+Defines class hardware_counters, which counts processor events in the
+calling thread with the perf_event_open system call of Linux: cycles,
+instructions, branch mispredictions, L1 data cache read misses,
+last-level cache misses and data TLB read misses, in user mode only.
+They tell why one algorithm is faster than another where the operation
+counts of counter and iteration_counter do not, for instance when two
+partitioning loops make the same comparisons but mispredict a
+different number of them.
+
+Each event is opened on its own, so that an event the processor does
+not have, or that the kernel does not let the process count, as in
+many containers and virtual machines, is left out while the others are
+still counted.  An event that could not be opened reads as -1, and on
+systems other than Linux every event does.  When the kernel has to
+share the counters between more events than the processor has, each
+count is scaled up by the fraction of the time it was actually
+counted.
+
+*/
+
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <sys/types.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum hardware_event {
+  hw_cycles,
+  hw_instructions,
+  hw_branch_misses,
+  hw_l1d_misses,
+  hw_llc_misses,
+  hw_dtlb_misses,
+  hardware_event_count
+};
+
+static const char* const hardware_event_names[hardware_event_count] =
+  {"cycles",
+   "instructions",
+   "branch misses",
+   "L1D misses",
+   "LLC misses",
+   "dTLB misses"};
+
+/* The counts of one measurement, -1 for the events that are not
+   available. */
+struct hardware_counts {
+  ssize_t values[hardware_event_count];
+
+  hardware_counts(
+  ){
+    for (int e = 0; e < hardware_event_count; ++e)
+      values[e] = -1;
+  }
+};
+
+class hardware_counters {
+protected:
+  int fds[hardware_event_count];
+  int error;
+
+#ifdef __linux__
+  static
+  int
+  open_event(
+    uint32_t type,
+    uint64_t config
+  ){
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  static
+  uint64_t
+  cache_event(
+    uint64_t cache,
+    uint64_t op,
+    uint64_t result
+  ){
+    return cache | (op << 8) | (result << 16);
+  }
+#endif
+
+public:
+  hardware_counters(
+  ) : error(0) {
+    for (int e = 0; e < hardware_event_count; ++e)
+      fds[e] = -1;
+#ifdef __linux__
+    fds[hw_cycles] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[hw_instructions] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[hw_branch_misses] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fds[hw_l1d_misses] = open_event(PERF_TYPE_HW_CACHE,
+      cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                  PERF_COUNT_HW_CACHE_RESULT_MISS));
+    fds[hw_llc_misses] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[hw_dtlb_misses] = open_event(PERF_TYPE_HW_CACHE,
+      cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                  PERF_COUNT_HW_CACHE_RESULT_MISS));
+    if (!any_available())
+      error = errno;
+#else
+    error = ENOSYS;
+#endif
+  }
+
+  hardware_counters(const hardware_counters&) = delete;
+  hardware_counters& operator=(const hardware_counters&) = delete;
+
+  ~hardware_counters(
+  ){
+#ifdef __linux__
+    for (int e = 0; e < hardware_event_count; ++e)
+      if (fds[e] >= 0)
+        close(fds[e]);
+#endif
+  }
+
+  bool
+  available(
+    int e
+  ) const {
+    return fds[e] >= 0;
+  }
+
+  bool
+  any_available(
+  ) const {
+    for (int e = 0; e < hardware_event_count; ++e)
+      if (available(e))
+        return true;
+    return false;
+  }
+
+  /* Why no event could be opened. */
+  const char*
+  reason(
+  ) const {
+    return std::strerror(error);
+  }
+
+  void
+  start(
+  ){
+#ifdef __linux__
+    for (int e = 0; e < hardware_event_count; ++e)
+      if (available(e)) {
+        ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+  }
+
+  void
+  stop(
+  ){
+#ifdef __linux__
+    for (int e = 0; e < hardware_event_count; ++e)
+      if (available(e))
+        ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+  }
+
+  /* The counts between the last start and stop. */
+  hardware_counts
+  counts(
+  ) const {
+    hardware_counts result;
+#ifdef __linux__
+    for (int e = 0; e < hardware_event_count; ++e) {
+      uint64_t value[3];
+      if (!available(e) || read(fds[e], value, sizeof(value)) != ssize_t(sizeof(value)))
+        continue;
+      if (value[2] == 0)
+        result.values[e] = 0;
+      else if (value[2] < value[1])
+        result.values[e] = ssize_t(double(value[0]) * value[1] / value[2]);
+      else
+        result.values[e] = ssize_t(value[0]);
+    }
+#endif
+    return result;
+  }
+};
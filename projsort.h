@@ -0,0 +1,206 @@
+/*
+
+Defines projected_introsort, which sorts [first, last) by the keys that
+a projection computes from the elements, for when computing a key is
+expensive: parsing a timestamp, normalizing a string prefix.  Sorting
+with a comparator that projects both of its arguments computes about
+2 N log N keys; projected_introsort instead computes each key once,
+into a compact array of (key, index) entries, sorts the entries with
+introsort and then moves every element to its place by following the
+cycles of the resulting permutation, so that it computes N keys and
+moves each element once.  Like introsort, it is not stable.
+
+Also defines argsort, which leaves [first, last) as it is and sorts an
+array of the indices of its elements instead, and indirect_introsort,
+which applies the permutation that argsort finds to the elements in
+the same way.  For large records, whose moves dominate the cost of
+partitioning, indirect_introsort moves 8-byte indices during the sort
+and each record only once, at the end.
+
+*/
+
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "intsort.h"
+
+/* An entry of the key array: a cached key and the position of the
+   element it was computed from. */
+template <
+  typename Key,
+  typename Index>
+struct keyed_index {
+  Key key;
+  Index index;
+};
+
+/*
+Rearranges [first, first + n) so that the element at position i is the
+one that was at position *(index + i).  Each element is moved once,
+plus one move to and from a temporary per cycle of the permutation.
+The index array is used to mark the finished positions, and so is
+left holding the identity permutation.
+*/
+template <
+  typename RandomAccessIterator,
+  typename IndexIterator>
+void
+apply_permutation(
+  RandomAccessIterator first,
+  IndexIterator index,
+  typename std::iterator_traits<RandomAccessIterator>::difference_type n
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  for (Distance i = 0; i < n; ++i) {
+    if (Distance(*(index + i)) == i)
+      continue;
+    T value = std::move(*(first + i));
+    Distance hole = i;
+    for (;;) {
+      Distance source = *(index + hole);
+      *(index + hole) = hole;
+      if (source == i)
+        break;
+      *(first + hole) = std::move(*(first + source));
+      hole = source;
+    }
+    *(first + hole) = std::move(value);
+  }
+}
+
+/*
+Sorts [first, last) by the keys proj computes.  Like the other sorts
+here, comp compares through iterators, here ones to keys, so that
+__gnu_cxx::__ops::__iter_less_iter() sorts into increasing order of
+the keys and __gnu_cxx::__ops::__iter_comp_iter(f) by a function f of
+two keys.
+*/
+template <
+  typename RandomAccessIterator,
+  typename Projection,
+  typename Compare>
+void
+projected_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Projection proj,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+  typedef typename std::iterator_traits<RandomAccessIterator>::reference Reference;
+  typedef typename std::decay<
+    typename std::invoke_result<Projection&, Reference>::type>::type Key;
+  typedef keyed_index<Key, Distance> entry;
+
+  Distance n = last - first;
+  if (n < Distance(2))
+    return;
+
+  std::vector<entry> keys;
+  keys.reserve(n);
+  for (Distance i = 0; i < n; ++i)
+    keys.push_back(entry{std::invoke(proj, *(first + i)), i});
+
+  introsort(keys.begin(), keys.end(),
+            __gnu_cxx::__ops::__iter_comp_iter(
+              [&comp](const entry& x, const entry& y) {
+                return comp(&x.key, &y.key);
+              }));
+
+  std::vector<Distance> index(n);
+  for (Distance i = 0; i < n; ++i)
+    index[i] = keys[i].index;
+  keys.clear();
+  keys.shrink_to_fit();
+  apply_permutation(first, index.begin(), n);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Projection>
+inline
+void
+projected_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Projection proj
+){
+  projected_introsort(first, last, proj, __gnu_cxx::__ops::__iter_less_iter());
+}
+
+/*
+Fills [index, index + (last - first)) with the positions of the
+elements of [first, last) in sorted order, so that *(first + *index)
+is the smallest, without moving the elements.
+*/
+template <
+  typename RandomAccessIterator,
+  typename IndexIterator,
+  typename Compare>
+void
+argsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  IndexIterator index,
+  Compare comp
+){
+  typedef typename std::iterator_traits<IndexIterator>::value_type Index;
+
+  Index n = last - first;
+  for (Index i = 0; i < n; ++i)
+    *(index + i) = i;
+  if (n < Index(2))
+    return;
+  introsort(index, index + n,
+            __gnu_cxx::__ops::__iter_comp_iter(
+              [first, &comp](Index i, Index j) {
+                return comp(first + i, first + j);
+              }));
+}
+
+template <
+  typename RandomAccessIterator,
+  typename IndexIterator>
+inline
+void
+argsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  IndexIterator index
+){
+  argsort(first, last, index, __gnu_cxx::__ops::__iter_less_iter());
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+indirect_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+
+  std::vector<Distance> index(last - first);
+  argsort(first, last, index.begin(), comp);
+  apply_permutation(first, index.begin(), last - first);
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+void
+indirect_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  indirect_introsort(first, last, __gnu_cxx::__ops::__iter_less_iter());
+}
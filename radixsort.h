@@ -0,0 +1,329 @@
+/*
+
+Defines radix sorts for value types that expose a radix key: an
+unsigned integer whose ordering is the ordering of the values.
+radix_traits<T> supplies the key.  It is defined for the built-in
+integer types, with the sign bit flipped for signed ones; for float
+and double, with the IEEE 754 transform that flips the sign bit of
+positive numbers and every bit of negative ones; for pairs of keyed
+types whose keys fit together in 64 bits, as a fixed-width composite
+key; and for any class with a member function radix_key().
+
+lsd_radix_sort sorts by one byte of the key per pass from the least
+significant one, through a buffer of the same size as the range, and
+skips the passes in which every key has the same byte.  msd_radix_sort
+is the in-place ``American flag'' sort: it permutes the range into 256
+buckets by the most significant byte and recurses into each bucket
+with the next byte, finishing buckets of at most msd_radix_threshold
+elements with introsort.
+
+radix_sort picks one of the two by the width of the key.
+radix_introsort is the automatic dispatch used by introsort: it sorts
+ranges of a keyed type of at least radix_crossover elements, or
+wide_radix_crossover for 64-bit keys, which radix_sort sorts with
+msd_radix_sort, and returns true, or returns false and leaves the
+range untouched.  introsort(first, last) tries simd_introsort first,
+so on processors with AVX2 or AVX-512 contiguous ranges of int, float
+and double never reach radix_introsort; the crossovers are measured on
+unsigned and 64-bit keys, which do, against the comparison introsort
+they would otherwise get.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tuning.h"
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp);
+
+const ptrdiff_t radix_crossover = INTROSORT_RADIX_CROSSOVER;
+
+const ptrdiff_t wide_radix_crossover = INTROSORT_WIDE_RADIX_CROSSOVER;
+
+const ptrdiff_t msd_radix_threshold = 64;
+
+template <
+  typename T,
+  typename Enable = void>
+struct radix_traits {
+  static const bool enabled = false;
+};
+
+template <typename T>
+struct radix_traits<T, typename std::enable_if<
+    std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+  static const bool enabled = true;
+  typedef typename std::make_unsigned<T>::type key_type;
+
+  static key_type key(T x) {
+    if (std::is_signed<T>::value)
+      return key_type(x) ^ (key_type(1) << (8 * sizeof(T) - 1));
+    return key_type(x);
+  }
+};
+
+template <>
+struct radix_traits<float> {
+  static const bool enabled = true;
+  typedef uint32_t key_type;
+
+  static key_type key(float x) {
+    key_type bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+  }
+};
+
+template <>
+struct radix_traits<double> {
+  static const bool enabled = true;
+  typedef uint64_t key_type;
+
+  static key_type key(double x) {
+    key_type bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits & 0x8000000000000000ull ? ~bits : bits | 0x8000000000000000ull;
+  }
+};
+
+template <typename T>
+struct radix_traits<T, typename std::enable_if<
+    std::is_unsigned<decltype(std::declval<const T&>().radix_key())>::value>::type> {
+  static const bool enabled = true;
+  typedef decltype(std::declval<const T&>().radix_key()) key_type;
+
+  static key_type key(const T& x) {
+    return x.radix_key();
+  }
+};
+
+template <
+  typename A,
+  typename B>
+struct radix_traits<std::pair<A, B>, typename std::enable_if<
+    radix_traits<A>::enabled && radix_traits<B>::enabled
+    && sizeof(typename radix_traits<A>::key_type)
+       + sizeof(typename radix_traits<B>::key_type) <= sizeof(uint64_t)>::type> {
+  static const bool enabled = true;
+  typedef typename std::conditional<
+    sizeof(typename radix_traits<A>::key_type)
+    + sizeof(typename radix_traits<B>::key_type) <= sizeof(uint32_t),
+    uint32_t, uint64_t>::type key_type;
+
+  static key_type key(const std::pair<A, B>& x) {
+    return key_type(radix_traits<A>::key(x.first))
+             << (8 * sizeof(typename radix_traits<B>::key_type))
+           | key_type(radix_traits<B>::key(x.second));
+  }
+};
+
+template <typename T>
+inline
+unsigned
+radix_digit(
+  const T& x,
+  int digit
+){
+  return unsigned(radix_traits<T>::key(x) >> (8 * digit)) & 0xff;
+}
+
+/* Comparison of radix keys, for the comparison sorts that finish the
+   small buckets of msd_radix_sort. */
+template <typename T>
+struct radix_key_less {
+  bool operator()(const T& x, const T& y) const {
+    return radix_traits<T>::key(x) < radix_traits<T>::key(y);
+  }
+};
+
+/* One stable counting pass of lsd_radix_sort. */
+template <
+  typename InputIterator,
+  typename OutputIterator>
+void
+radix_scatter(
+  InputIterator first,
+  InputIterator last,
+  OutputIterator result,
+  const size_t* counts,
+  int digit
+){
+  size_t offsets[256];
+  size_t sum = 0;
+  for (int b = 0; b < 256; ++b) {
+    offsets[b] = sum;
+    sum += counts[b];
+  }
+  for (; first != last; ++first)
+    result[offsets[radix_digit(*first, digit)]++] = std::move(*first);
+}
+
+template <
+  typename RandomAccessIterator>
+void
+lsd_radix_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  typedef typename radix_traits<T>::key_type Key;
+  const int digits = sizeof(Key);
+
+  size_t n = last - first;
+  if (n < 2)
+    return;
+
+  std::vector<size_t> counts(digits * 256);
+  for (RandomAccessIterator i = first; i != last; ++i) {
+    Key k = radix_traits<T>::key(*i);
+    for (int d = 0; d < digits; ++d)
+      ++counts[d * 256 + (unsigned(k >> (8 * d)) & 0xff)];
+  }
+
+  std::vector<T> buffer(n);
+  bool in_buffer = false;
+  for (int d = 0; d < digits; ++d) {
+    const size_t* c = &counts[d * 256];
+    if (std::find(c, c + 256, n) != c + 256)
+      continue;
+    if (in_buffer)
+      radix_scatter(buffer.begin(), buffer.end(), first, c, d);
+    else
+      radix_scatter(first, last, buffer.begin(), c, d);
+    in_buffer = !in_buffer;
+  }
+  if (in_buffer)
+    std::move(buffer.begin(), buffer.end(), first);
+}
+
+template <
+  typename RandomAccessIterator>
+void
+msd_radix_sort_loop(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  int digit
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+
+  for (;;) {
+    Distance n = last - first;
+    if (n <= msd_radix_threshold) {
+      introsort(first, last, __gnu_cxx::__ops::__iter_comp_iter(radix_key_less<T>()));
+      return;
+    }
+
+    Distance counts[256] = {0};
+    for (RandomAccessIterator i = first; i != last; ++i)
+      ++counts[radix_digit(*i, digit)];
+
+    if (counts[radix_digit(*first, digit)] == n) {
+      if (digit == 0)
+        return;
+      --digit;
+      continue;
+    }
+
+    Distance heads[256], tails[256];
+    Distance sum = 0;
+    for (int b = 0; b < 256; ++b) {
+      heads[b] = sum;
+      sum += counts[b];
+      tails[b] = sum;
+    }
+
+    for (int b = 0; b < 256; ++b) {
+      while (heads[b] < tails[b]) {
+        T x = std::move(first[heads[b]]);
+        unsigned c = radix_digit(x, digit);
+        while (c != unsigned(b)) {
+          std::swap(x, first[heads[c]++]);
+          c = radix_digit(x, digit);
+        }
+        first[heads[b]++] = std::move(x);
+      }
+    }
+
+    if (digit == 0)
+      return;
+    Distance start = 0;
+    for (int b = 0; b < 256; ++b) {
+      if (counts[b] > 1)
+        msd_radix_sort_loop(first + start, first + (start + counts[b]), digit - 1);
+      start += counts[b];
+    }
+    return;
+  }
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+void
+msd_radix_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if (last - first > 1)
+    msd_radix_sort_loop(first, last, int(sizeof(typename radix_traits<T>::key_type)) - 1);
+}
+
+/*
+Keys of up to 32 bits take at most four passes of lsd_radix_sort.
+Wider keys use msd_radix_sort, which usually runs out of distinct keys
+within a bucket after two or three bytes and needs no buffer.
+*/
+template <
+  typename RandomAccessIterator>
+inline
+void
+radix_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if (sizeof(typename radix_traits<T>::key_type) <= sizeof(uint32_t))
+    lsd_radix_sort(first, last);
+  else
+    msd_radix_sort(first, last);
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+bool
+radix_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if constexpr (!radix_traits<T>::enabled) {
+    return false;
+  } else {
+    const ptrdiff_t crossover =
+      sizeof(typename radix_traits<T>::key_type) <= sizeof(uint32_t)
+        ? radix_crossover : wide_radix_crossover;
+    if (last - first < crossover)
+      return false;
+    radix_sort(first, last);
+    return true;
+  }
+}
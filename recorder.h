@@ -7,6 +7,14 @@ computing times as measured by objects of class Timer.  See also
 recorder0.h, which defines a simpler recorder class capable only of
 recording computing times.
 
+The counts are kept in per-thread shards (see shardcount.h); record
+combines the shards of every thread that counted, so a measurement
+may include sorts run on a task_pool or several threads at once, as
+long as they have finished when record is called.  Next to them it
+records the processor events of hardware_counters (see perfcount.h),
+and reports the ones that could not be counted as -, and breaks the
+counts and the time down by the phases of costphase.h.
+
 */
 
 /*
@@ -26,9 +34,12 @@ recording computing times.
 
 #include <iomanip>
 #include <iostream>
+#include <string>
 #include <vector>
 
+#include "costphase.h"
 #include "counting.h"
+#include "perfcount.h"
 
 using std::cout;
 using std::ios;
@@ -82,11 +93,25 @@ class recorder
   vector<ssize_t> ic_max_generation;
 
   vector<double> times;
+  vector<double> counted_times;
+
+  vector<ssize_t> hw_counts[hardware_event_count];
+
+  vector<double> phase_times[cost_phase_count];
+  vector<ssize_t> phase_data[cost_phase_count];
+  vector<ssize_t> phase_distance[cost_phase_count];
+  vector<ssize_t> phase_iterator[cost_phase_count];
 public:
 
+  /* Records the counts of the instrumented run that just finished, the
+     time of an uninstrumented run of the same algorithm, time_taken,
+     the time of the instrumented one, counted_time, and the hardware
+     events of the uninstrumented run. */
   void
   record(
-    const double time_taken
+    const double time_taken,
+    const double counted_time,
+    const hardware_counts& events = hardware_counts()
   ){
 
     c_assignments.push_back(DataCounter::assignments);
@@ -114,6 +139,17 @@ public:
     ic_max_generation.push_back(IterationCounter::max_generation);
 
     times.push_back(time_taken);
+    counted_times.push_back(counted_time);
+    for (int e = 0; e < hardware_event_count; ++e)
+      hw_counts[e].push_back(events.values[e]);
+
+    for (int p = 0; p < cost_phase_count; ++p) {
+      phase_times[p].push_back(cost_phase_nanoseconds.in_phase(p) * 1e-9);
+      phase_data[p].push_back(DataCounter::total(p));
+      phase_distance[p].push_back(DistanceCounter::total(p));
+      phase_iterator[p].push_back(IterationCounter::total(p));
+    }
+    cost_phase_nanoseconds = 0;
 
     DataCounter::reset();
     IterationCounter::reset();
@@ -178,6 +214,7 @@ public:
 
     o << setiosflags(ios::fixed) << setprecision(3)
       << setw(width) << median(times)/repeat_factor
+      << setw(width) << median(counted_times)/repeat_factor
       << setw(width) << data_assignments
       << setw(width) << data_comparisons
       << setw(width) << data_accesses
@@ -199,8 +236,41 @@ public:
       << setw(width) << iterator_bigjumps
       << setw(width) << iterator_comparisons
       << setw(width) << iterator_max_generation
-      << setw(width) << total
-      << endl;
+      << setw(width) << total;
+
+    for (int e = 0; e < hardware_event_count; ++e) {
+      ssize_t count = median(hw_counts[e]);
+      if (count < 0)
+        o << setw(width) << "-";
+      else
+        o << setw(width) << count / repeat_factor;
+    }
+    o << endl;
+  }
+
+  /*
+  Reports, for each phase of costphase.h, the time of the phase-timed
+  run and the data, distance and iterator operations of the counted
+  one, one phase per line, the first line after heading.
+  */
+  void
+  report_phases(
+    std::ostream& o,
+    const std::string& heading,
+    int repeat_factor
+  ){
+    int width = 30;
+
+    for (int p = 0; p < cost_phase_count; ++p) {
+      o << setiosflags(ios::fixed) << setprecision(3)
+        << setw(width) << (p == 0 ? heading : std::string())
+        << setw(width) << cost_phase_names[p]
+        << setw(width) << median(phase_times[p])/repeat_factor
+        << setw(width) << median(phase_data[p]) / repeat_factor
+        << setw(width) << median(phase_distance[p]) / repeat_factor
+        << setw(width) << median(phase_iterator[p]) / repeat_factor
+        << endl;
+    }
   }
 
   void
@@ -228,5 +298,14 @@ public:
     ic_comparisons.clear();
     ic_max_generation.clear();
     times.clear();
+    counted_times.clear();
+    for (int e = 0; e < hardware_event_count; ++e)
+      hw_counts[e].clear();
+    for (int p = 0; p < cost_phase_count; ++p) {
+      phase_times[p].clear();
+      phase_data[p].clear();
+      phase_distance[p].clear();
+      phase_iterator[p].clear();
+    }
   }
 };
@@ -0,0 +1,559 @@
+/*
+
+Defines samplesort, an in-place parallel samplesort after Axtmann,
+Witt, Ferizovic and Sanders, ``In-place Parallel Super Scalar
+Samplesort (IPS4o)''.  One distribution step of a range
+
+  - draws a sample, sorts it with introsort and picks up to 255
+    splitters, which are laid out as an implicit search tree so that
+    an element is classified with log2(buckets) comparisons and no
+    conditional branch;
+  - has every thread classify one stripe of the range into per-bucket
+    buffers of one block each, writing every full buffer back to the
+    front of its stripe as a block;
+  - permutes the blocks so that each bucket's blocks form a run at the
+    start of the bucket, several threads moving blocks at once;
+  - fills the gaps at both ends of each bucket from the partly filled
+    buffers.
+
+Buckets are then distributed in turn, one task per bucket, until they
+hold at most samplesort_base elements, and those are sorted with
+introsort.  When the sample has repeated keys, every repeated splitter
+gets an equality bucket of its own, which needs no further sorting.
+Apart from the range itself, one step uses one buffer block per bucket
+and thread, and a few words per block.
+
+The overload that takes a task_pool uses all of the pool's threads;
+the other one runs on the calling thread alone.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "intsort.h"
+#include "taskpool.h"
+
+const ptrdiff_t samplesort_base = 1 << 10;
+
+const int samplesort_max_log_buckets = 8;
+
+const int samplesort_oversampling = 16;
+
+const ptrdiff_t samplesort_block_bytes = 2048;
+
+const int samplesort_max_depth = 16;
+
+/* Runs f(0), ..., f(threads - 1) on the pool's threads and waits. */
+template <
+  typename Function>
+void
+samplesort_parallel(
+  task_pool* pool,
+  size_t threads,
+  Function f
+){
+  if (threads == 1) {
+    f(0);
+    return;
+  }
+  std::atomic<ssize_t> outstanding(threads - 1);
+  for (size_t i = 1; i < threads; ++i)
+    pool->submit([&f, &outstanding, i]{
+      f(i);
+      --outstanding;
+    });
+  f(0);
+  pool->wait(outstanding);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+class samplesort_step {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+
+  struct stripe {
+    std::vector<T> buffer;
+    std::vector<Distance> fill;
+    std::vector<Distance> count;
+    std::vector<T> swap;
+  };
+
+  struct bucket_pointers {
+    std::mutex lock;
+    Distance write;
+    Distance read;
+    std::atomic<int> readers;
+  };
+
+  RandomAccessIterator first;
+  Distance n;
+  Compare comp;
+  size_t threads;
+
+  int log_buckets;
+  int leaves;
+  bool equality;
+  int buckets;
+  std::vector<T> tree;
+  std::vector<T> splitters;
+
+  Distance block;
+  Distance stripe_size;
+  std::vector<stripe> stripes;
+  std::vector<int> label;
+  std::vector<Distance> bucket_start;
+  std::vector<Distance> first_block;
+  std::vector<Distance> full_blocks;
+  std::vector<bucket_pointers> pointers;
+  std::vector<T> overflow;
+  int overflow_bucket;
+  std::vector<std::vector<T> > spill;
+
+  Distance
+  slot_end(
+    int b
+  ) const {
+    return b + 1 < buckets ? first_block[b + 1] : (n + block - 1) / block;
+  }
+
+  void
+  build_tree(
+    size_t node,
+    int lo,
+    int hi
+  ){
+    if (node >= size_t(leaves))
+      return;
+    int mid = lo + (hi - lo) / 2;
+    tree[node] = splitters[mid];
+    build_tree(2 * node, lo, mid);
+    build_tree(2 * node + 1, mid + 1, hi);
+  }
+
+  int
+  classify(
+    RandomAccessIterator i
+  ){
+    size_t node = 1;
+    for (int l = 0; l < log_buckets; ++l)
+      node = 2 * node + !comp(i, tree.begin() + node);
+    int b = int(node) - leaves;
+    if (!equality)
+      return b;
+    if (b > 0 && !comp(splitters.begin() + (b - 1), i))
+      return 2 * b - 1;
+    return 2 * b;
+  }
+
+  void
+  write_block(
+    const T* source,
+    Distance slot
+  ){
+    Distance start = slot * block;
+    if (start + block > n)
+      std::copy(source, source + block, overflow.begin());
+    else
+      std::copy(source, source + block, first + start);
+  }
+
+public:
+  samplesort_step(
+    RandomAccessIterator first,
+    RandomAccessIterator last,
+    Compare comp,
+    size_t threads
+  ) : first(first), n(last - first), comp(comp), threads(threads) {}
+
+  /* Chooses the splitters; returns false if the sample has a single
+     distinct key, in which case the range is left to introsort. */
+  bool
+  sample(
+  ){
+    log_buckets = 1;
+    while (log_buckets < samplesort_max_log_buckets
+           && (Distance(samplesort_base) << log_buckets) < n)
+      ++log_buckets;
+    leaves = 1 << log_buckets;
+
+    Distance size = std::min(n, Distance(samplesort_oversampling) * leaves);
+    std::vector<T> s;
+    s.reserve(size);
+    unsigned long long state = 0x9e3779b97f4a7c15ull ^ (unsigned long long)n;
+    for (Distance i = 0; i < size; ++i) {
+      state = state * 6364136223846793005ull + 1442695040888963407ull;
+      s.push_back(first[Distance((state >> 33) % (unsigned long long)n)]);
+    }
+    introsort(s.begin(), s.end(), comp);
+
+    Distance step = size / leaves;
+    for (int i = 1; i < leaves; ++i)
+      splitters.push_back(s[i * step]);
+    typename std::vector<T>::iterator unique_end = std::unique(
+      splitters.begin(), splitters.end(),
+      [this](const T& x, const T& y) {
+        return !comp(&x, &y) && !comp(&y, &x);
+      });
+    equality = unique_end != splitters.end();
+    splitters.erase(unique_end, splitters.end());
+    if (equality && splitters.size() == 1
+        && !comp(s.begin(), s.end() - 1) && !comp(s.end() - 1, s.begin()))
+      return false;
+    while (splitters.size() < size_t(leaves - 1))
+      splitters.push_back(splitters.back());
+
+    tree.resize(leaves);
+    build_tree(1, 0, leaves - 1);
+    buckets = equality ? 2 * leaves - 1 : leaves;
+
+    block = std::max(Distance(1), Distance(samplesort_block_bytes / sizeof(T)));
+    stripe_size = ((n + Distance(threads) - 1) / Distance(threads) + block - 1) / block * block;
+    stripes.resize(threads);
+    label.assign((n + block - 1) / block, -1);
+    return true;
+  }
+
+  /* Local classification of stripe i. */
+  void
+  classify_stripe(
+    size_t i
+  ){
+    stripe& s = stripes[i];
+    s.buffer.resize(buckets * block);
+    s.fill.assign(buckets, 0);
+    s.count.assign(buckets, 0);
+    s.swap.resize(2 * block);
+
+    Distance begin = std::min(n, Distance(i) * stripe_size);
+    Distance end = std::min(n, begin + stripe_size);
+    Distance write = begin;
+    for (Distance j = begin; j < end; ++j) {
+      int b = classify(first + j);
+      s.buffer[b * block + s.fill[b]] = std::move(first[j]);
+      ++s.count[b];
+      if (++s.fill[b] == block) {
+        std::move(s.buffer.begin() + b * block, s.buffer.begin() + (b + 1) * block,
+                  first + write);
+        label[write / block] = b;
+        write += block;
+        s.fill[b] = 0;
+      }
+    }
+  }
+
+  /* Bucket boundaries, and for every bucket the number of its blocks. */
+  void
+  count(
+  ){
+    bucket_start.assign(buckets + 1, 0);
+    full_blocks.assign(buckets, 0);
+    first_block.assign(buckets, 0);
+    for (int b = 0; b < buckets; ++b) {
+      Distance total = 0, buffered = 0;
+      for (size_t i = 0; i < threads; ++i) {
+        total += stripes[i].count[b];
+        buffered += stripes[i].fill[b];
+      }
+      bucket_start[b + 1] = bucket_start[b] + total;
+      full_blocks[b] = (total - buffered) / block;
+      first_block[b] = (bucket_start[b] + block - 1) / block;
+    }
+    pointers = std::vector<bucket_pointers>(buckets);
+    overflow.resize(block);
+    overflow_bucket = -1;
+    spill.assign(buckets, std::vector<T>());
+  }
+
+  /* Moves the full blocks among the slots of bucket b to the front of
+     them, so that they can be read from the back. */
+  void
+  gather_blocks(
+    int b
+  ){
+    Distance lo = first_block[b], hi = slot_end(b);
+    while (true) {
+      while (lo < hi && label[lo] >= 0)
+        ++lo;
+      while (lo < hi && label[hi - 1] < 0)
+        --hi;
+      if (lo + 1 >= hi)
+        break;
+      std::move(first + (hi - 1) * block, first + hi * block, first + lo * block);
+      label[lo] = label[hi - 1];
+      label[hi - 1] = -1;
+    }
+    Distance full = first_block[b];
+    while (full < slot_end(b) && label[full] >= 0)
+      ++full;
+    pointers[b].write = first_block[b];
+    pointers[b].read = full;
+    pointers[b].readers = 0;
+  }
+
+  /* Block permutation, run by every thread at once. */
+  void
+  permute(
+    size_t i
+  ){
+    stripe& s = stripes[i];
+    T* hand = &s.swap[0];
+    T* other = &s.swap[block];
+    int primary = int(i * buckets / threads);
+
+    for (int k = 0; k < buckets; ++k) {
+      int b = (primary + k) % buckets;
+      for (;;) {
+        Distance slot;
+        {
+          bucket_pointers& p = pointers[b];
+          std::lock_guard<std::mutex> guard(p.lock);
+          while (p.write < p.read && label[p.write] == b)
+            ++p.write;
+          if (p.write >= p.read)
+            break;
+          slot = --p.read;
+          ++p.readers;
+        }
+        int c = label[slot];
+        std::move(first + slot * block, first + (slot + 1) * block, hand);
+        --pointers[b].readers;
+
+        for (;;) {
+          bucket_pointers& p = pointers[c];
+          Distance dst;
+          bool full;
+          {
+            std::lock_guard<std::mutex> guard(p.lock);
+            while (p.write < p.read && label[p.write] == c)
+              ++p.write;
+            dst = p.write++;
+            full = dst < p.read;
+          }
+          if (full) {
+            int d = label[dst];
+            std::move(first + dst * block, first + (dst + 1) * block, other);
+            write_block(hand, dst);
+            label[dst] = c;
+            std::swap(hand, other);
+            c = d;
+          } else {
+            while (p.readers > 0)
+              std::this_thread::yield();
+            write_block(hand, dst);
+            label[dst] = c;
+            if (dst * block + block > n)
+              overflow_bucket = c;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  /* Saves the elements of each bucket's last block that lie beyond the
+     end of the bucket, before the next bucket's gap is filled. */
+  void
+  save_spill(
+  ){
+    for (int b = 0; b < buckets; ++b) {
+      Distance end = bucket_start[b + 1];
+      Distance blocks_end = (first_block[b] + full_blocks[b]) * block;
+      if (full_blocks[b] == 0 || blocks_end <= end)
+        continue;
+      Distance last_start = blocks_end - block;
+      if (b == overflow_bucket) {
+        for (Distance j = last_start; j < blocks_end; ++j)
+          if (j < end)
+            first[j] = std::move(overflow[j - last_start]);
+          else
+            spill[b].push_back(std::move(overflow[j - last_start]));
+      } else {
+        for (Distance j = end; j < blocks_end; ++j)
+          spill[b].push_back(std::move(first[j]));
+      }
+    }
+  }
+
+  /* Fills the gaps at both ends of bucket b. */
+  void
+  cleanup(
+    int b
+  ){
+    Distance start = bucket_start[b], end = bucket_start[b + 1];
+    Distance blocks_start = std::min(end, first_block[b] * block);
+    Distance blocks_end = std::min(end, (first_block[b] + full_blocks[b]) * block);
+    if (full_blocks[b] == 0)
+      blocks_start = blocks_end = end;
+
+    Distance position = start;
+    auto put = [&](T& x) {
+      if (position == blocks_start)
+        position = blocks_end;
+      first[position++] = std::move(x);
+    };
+    for (T& x : spill[b])
+      put(x);
+    for (size_t i = 0; i < threads; ++i) {
+      stripe& s = stripes[i];
+      for (Distance j = 0; j < s.fill[b]; ++j)
+        put(s.buffer[b * block + j]);
+    }
+  }
+
+  void
+  distribute(
+    task_pool* pool
+  ){
+    samplesort_parallel(pool, threads, [this](size_t i) { classify_stripe(i); });
+    count();
+    samplesort_parallel(pool, threads, [this](size_t i) {
+      for (int b = int(i); b < buckets; b += int(threads))
+        gather_blocks(b);
+    });
+    samplesort_parallel(pool, threads, [this](size_t i) { permute(i); });
+    save_spill();
+    samplesort_parallel(pool, threads, [this](size_t i) {
+      for (int b = int(i); b < buckets; b += int(threads))
+        cleanup(b);
+    });
+  }
+
+  int
+  bucket_count(
+  ) const {
+    return buckets;
+  }
+
+  Distance
+  bucket_begin(
+    int b
+  ) const {
+    return bucket_start[b];
+  }
+
+  /* Whether bucket b holds only keys equal to a splitter. */
+  bool
+  equality_bucket(
+    int b
+  ) const {
+    return equality && b % 2 == 1;
+  }
+};
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+samplesort_loop(
+  task_pool* pool,
+  std::atomic<ssize_t>* outstanding,
+  size_t threads,
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  int depth
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+
+  Distance n = last - first;
+  if (n <= samplesort_base || depth == samplesort_max_depth) {
+    if (n > 1)
+      introsort(first, last, comp);
+    return;
+  }
+
+  samplesort_step<RandomAccessIterator, Compare> step(first, last, comp, threads);
+  if (!step.sample()) {
+    introsort(first, last, comp);
+    return;
+  }
+  step.distribute(pool);
+
+  for (int b = 0; b < step.bucket_count(); ++b) {
+    if (step.equality_bucket(b))
+      continue;
+    Distance begin = step.bucket_begin(b);
+    Distance end = b + 1 < step.bucket_count() ? step.bucket_begin(b + 1) : n;
+    if (end - begin < 2)
+      continue;
+    if (end - begin == n) {
+      introsort(first, last, comp);
+      return;
+    }
+    RandomAccessIterator bucket_first = first + begin;
+    RandomAccessIterator bucket_last = first + end;
+    if (outstanding) {
+      ++*outstanding;
+      pool->submit([outstanding, bucket_first, bucket_last, comp, depth]{
+        samplesort_loop<RandomAccessIterator, Compare>(
+          nullptr, nullptr, 1, bucket_first, bucket_last, comp, depth + 1);
+        --*outstanding;
+      });
+    } else {
+      samplesort_loop<RandomAccessIterator, Compare>(
+        nullptr, nullptr, 1, bucket_first, bucket_last, comp, depth + 1);
+    }
+  }
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+samplesort(
+  task_pool& pool,
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  std::atomic<ssize_t> outstanding(0);
+  samplesort_loop(&pool, &outstanding, pool.size(), first, last, comp, 0);
+  pool.wait(outstanding);
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+void
+samplesort(
+  task_pool& pool,
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  samplesort(pool, first, last, __gnu_cxx::__ops::__iter_less_iter());
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+samplesort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  samplesort_loop(static_cast<task_pool*>(nullptr),
+                  static_cast<std::atomic<ssize_t>*>(nullptr),
+                  1, first, last, comp, 0);
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+void
+samplesort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  samplesort(first, last, __gnu_cxx::__ops::__iter_less_iter());
+}
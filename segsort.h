@@ -0,0 +1,264 @@
+/*
+
+Defines segmented_sort, which sorts each of many short segments of a
+flat sequence: the segments of [first, ...) are
+[first + offsets[0], first + offsets[1]), [first + offsets[1],
+first + offsets[2]), and so on, for the offsets in
+[offsets_first, offsets_last).  Each segment is sorted by the cheapest
+method for its length:
+
+  - up to segment_network_limit elements, by an optimal sorting
+    network, unrolled for the length, which makes no data-dependent
+    branches for scalar values;
+  - up to the insertion sort threshold of introsort_traits, by
+    insertion sort alone;
+  - longer ones by introsort with the traits of the iterator type;
+  - without a comparison function, every segment longer than
+    segment_network_limit of int, float or double by the vectorized
+    introsort of simdsort.h, when the processor supports it.
+
+The overload that takes a task_pool splits the segments into batches
+of about grain elements and sorts the batches in parallel.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "intsort.h"
+#include "parsort.h"
+#include "taskpool.h"
+
+const ptrdiff_t segment_network_limit = 8;
+
+/* The comparators of optimal sorting networks for 2 to 8 elements,
+   those for n elements being sorting_network_pairs[
+   sorting_network_start[n] .. sorting_network_start[n + 1]). */
+constexpr unsigned char sorting_network_pairs[][2] = {
+  {0,1},
+  {0,2}, {0,1}, {1,2},
+  {0,2}, {1,3}, {0,1}, {2,3}, {1,2},
+  {0,3}, {1,4}, {0,2}, {1,3}, {0,1}, {2,4}, {1,2}, {3,4}, {2,3},
+  {0,5}, {1,3}, {2,4}, {1,2}, {3,4}, {0,3}, {2,5}, {0,1}, {2,3}, {4,5},
+  {1,2}, {3,4},
+  {0,6}, {2,3}, {4,5}, {0,2}, {1,4}, {3,6}, {0,1}, {2,5}, {3,4}, {1,2},
+  {4,6}, {2,3}, {4,5}, {1,2}, {3,4}, {5,6},
+  {0,2}, {1,3}, {4,6}, {5,7}, {0,4}, {1,5}, {2,6}, {3,7}, {0,1}, {2,3},
+  {4,5}, {6,7}, {2,4}, {3,5}, {1,4}, {3,6}, {1,2}, {3,4}, {5,6}
+};
+constexpr unsigned char sorting_network_start[] = {0, 0, 0, 1, 4, 9, 18, 30, 46, 65};
+
+/* Puts the smaller of *a and *b in *a, branch-free for scalar values. */
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+compare_exchange(
+  RandomAccessIterator a,
+  RandomAccessIterator b,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  if (std::is_scalar<T>::value) {
+    bool swap = comp(b, a);
+    T x = *a, y = *b;
+    *a = swap ? y : x;
+    *b = swap ? x : y;
+  } else if (comp(b, a)) {
+    std::iter_swap(a, b);
+  }
+}
+
+template <
+  int N,
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+sorting_network(
+  RandomAccessIterator first,
+  Compare comp
+){
+  for (int i = sorting_network_start[N]; i < sorting_network_start[N + 1]; ++i)
+    compare_exchange(first + sorting_network_pairs[i][0],
+                     first + sorting_network_pairs[i][1], comp);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+void
+sort_segment(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef iterator_introsort_traits<RandomAccessIterator> traits;
+
+  switch (last - first) {
+  case 0:
+  case 1: return;
+  case 2: sorting_network<2>(first, comp); return;
+  case 3: sorting_network<3>(first, comp); return;
+  case 4: sorting_network<4>(first, comp); return;
+  case 5: sorting_network<5>(first, comp); return;
+  case 6: sorting_network<6>(first, comp); return;
+  case 7: sorting_network<7>(first, comp); return;
+  case 8: sorting_network<8>(first, comp); return;
+  }
+  if (last - first <= traits::threshold) {
+    std::__insertion_sort(first, last, comp);
+    return;
+  }
+  tuned_introsort<traits>(first, last, comp);
+}
+
+/*
+Without a comparison function, segments longer than
+segment_network_limit of int, float or double are sorted by the
+vectorized introsort of simdsort.h when the processor supports it,
+which is several times faster than the scalar methods at every length
+above the limit.
+*/
+template <
+  typename RandomAccessIterator>
+inline
+void
+sort_segment(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  if (last - first > segment_network_limit && simd_introsort(first, last))
+    return;
+  sort_segment(first, last, __gnu_cxx::__ops::__iter_less_iter());
+}
+
+/* Applies sort to each segment of [offsets_first, offsets_last). */
+template <
+  typename RandomAccessIterator,
+  typename OffsetIterator,
+  typename SegmentSort>
+void
+sort_segments(
+  RandomAccessIterator first,
+  OffsetIterator offsets_first,
+  OffsetIterator offsets_last,
+  SegmentSort sort
+){
+  if (offsets_first == offsets_last)
+    return;
+  for (OffsetIterator o = offsets_first; ++o != offsets_last; )
+    sort(first + *(o - 1), first + *o);
+}
+
+/* Applies sort to batches of segments of about grain elements in
+   parallel. */
+template <
+  typename RandomAccessIterator,
+  typename OffsetIterator,
+  typename SegmentSort>
+void
+sort_segments(
+  task_pool& pool,
+  RandomAccessIterator first,
+  OffsetIterator offsets_first,
+  OffsetIterator offsets_last,
+  SegmentSort sort,
+  ptrdiff_t grain
+){
+  if (offsets_first == offsets_last)
+    return;
+  std::atomic<ssize_t> outstanding(0);
+  OffsetIterator batch = offsets_first;
+  while (batch + 1 != offsets_last) {
+    OffsetIterator end = batch + 1;
+    while (end + 1 != offsets_last && *end - *batch < grain)
+      ++end;
+    ++outstanding;
+    pool.submit([&outstanding, first, batch, end, sort]{
+      sort_segments(first, batch, end + 1, sort);
+      --outstanding;
+    });
+    batch = end;
+  }
+  pool.wait(outstanding);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename OffsetIterator,
+  typename Compare>
+inline
+void
+segmented_sort(
+  RandomAccessIterator first,
+  OffsetIterator offsets_first,
+  OffsetIterator offsets_last,
+  Compare comp
+){
+  sort_segments(first, offsets_first, offsets_last,
+                [comp](RandomAccessIterator f, RandomAccessIterator l) {
+                  sort_segment(f, l, comp);
+                });
+}
+
+template <
+  typename RandomAccessIterator,
+  typename OffsetIterator>
+inline
+void
+segmented_sort(
+  RandomAccessIterator first,
+  OffsetIterator offsets_first,
+  OffsetIterator offsets_last
+){
+  sort_segments(first, offsets_first, offsets_last,
+                [](RandomAccessIterator f, RandomAccessIterator l) {
+                  sort_segment(f, l);
+                });
+}
+
+template <
+  typename RandomAccessIterator,
+  typename OffsetIterator,
+  typename Compare>
+inline
+void
+segmented_sort(
+  task_pool& pool,
+  RandomAccessIterator first,
+  OffsetIterator offsets_first,
+  OffsetIterator offsets_last,
+  Compare comp,
+  ptrdiff_t grain = parallel_grain
+){
+  sort_segments(pool, first, offsets_first, offsets_last,
+                [comp](RandomAccessIterator f, RandomAccessIterator l) {
+                  sort_segment(f, l, comp);
+                }, grain);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename OffsetIterator>
+inline
+void
+segmented_sort(
+  task_pool& pool,
+  RandomAccessIterator first,
+  OffsetIterator offsets_first,
+  OffsetIterator offsets_last
+){
+  sort_segments(pool, first, offsets_first, offsets_last,
+                [](RandomAccessIterator f, RandomAccessIterator l) {
+                  sort_segment(f, l);
+                }, parallel_grain);
+}
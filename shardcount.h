@@ -0,0 +1,306 @@
+/*
+
+Defines classes sharded_count and sharded_max, the operation counts of
+counter, iteration_counter and distance_counter.  Every thread that
+counts gets its own shard, a block of count_shard_capacity slots
+aligned to a cache line, and each count object owns one slot in every
+shard; incrementing a count touches only the calling thread's slot,
+with a relaxed load and store rather than an atomic read-modify-write,
+so counting from many threads neither races nor shares cache lines.
+
+Reading a count, as recorder::record does after each measurement,
+combines its slots in all live shards with what the threads that have
+exited left behind: sharded_count adds them up and sharded_max takes
+the largest.  Reading and assigning a count are meant for when no
+thread is counting, between measurements; they lock the registry of
+shards and are not cheap.
+
+A thread has one shard for each phase it has counted in, and counts
+into the one of its current phase, which set_count_phase changes (see
+costphase.h).  in_phase combines only the shards of one phase, so the
+cost of an algorithm can be broken down by phase without any work in
+the counting itself.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <sys/types.h>
+
+const size_t count_shard_capacity = 256;
+const int count_phase_capacity = 8;
+
+/* One thread's slots for one phase. */
+struct alignas(64) count_shard {
+  std::atomic<ssize_t> values[count_shard_capacity];
+  int phase;
+
+  explicit
+  count_shard(
+    int phase
+  ) : phase(phase) {
+    for (size_t i = 0; i < count_shard_capacity; ++i)
+      values[i].store(0, std::memory_order_relaxed);
+  }
+};
+
+/* The live shards, and the counts of the threads that have exited. */
+class count_shard_registry {
+public:
+  std::mutex lock;
+  std::vector<count_shard*> live;
+  ssize_t retired[count_phase_capacity][count_shard_capacity];
+  bool maximum[count_shard_capacity];
+  size_t slots;
+
+  count_shard_registry() : retired(), maximum(), slots(0) {}
+
+  static
+  count_shard_registry&
+  get(
+  ){
+    static count_shard_registry registry;
+    return registry;
+  }
+
+  size_t
+  allocate(
+    bool is_maximum
+  ){
+    std::lock_guard<std::mutex> guard(lock);
+    assert(slots < count_shard_capacity);
+    maximum[slots] = is_maximum;
+    return slots++;
+  }
+
+  /* Folds the counts of an exiting thread into retired. */
+  void
+  retire(
+    count_shard* shard
+  ){
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < slots; ++i) {
+      ssize_t v = shard->values[i].load(std::memory_order_relaxed);
+      ssize_t& r = retired[shard->phase][i];
+      r = maximum[i] ? std::max(r, v) : r + v;
+    }
+    live.erase(std::find(live.begin(), live.end(), shard));
+  }
+
+  /* Combines slot over the shards of phase, or of every phase if phase
+     is negative. */
+  ssize_t
+  combine(
+    size_t slot,
+    int phase = -1
+  ){
+    std::lock_guard<std::mutex> guard(lock);
+    ssize_t result = 0;
+    for (int p = 0; p < count_phase_capacity; ++p)
+      if (phase < 0 || p == phase)
+        result = maximum[slot] ? std::max(result, retired[p][slot])
+                               : result + retired[p][slot];
+    for (count_shard* shard : live) {
+      if (phase >= 0 && shard->phase != phase)
+        continue;
+      ssize_t v = shard->values[slot].load(std::memory_order_relaxed);
+      result = maximum[slot] ? std::max(result, v) : result + v;
+    }
+    return result;
+  }
+
+  void
+  clear(
+    size_t slot
+  ){
+    std::lock_guard<std::mutex> guard(lock);
+    for (int p = 0; p < count_phase_capacity; ++p)
+      retired[p][slot] = 0;
+    for (count_shard* shard : live)
+      shard->values[slot].store(0, std::memory_order_relaxed);
+  }
+};
+
+/* Creates the calling thread's shard for a phase on first use and
+   retires its shards when the thread exits. */
+class count_shard_owner {
+public:
+  count_shard* shards[count_phase_capacity];
+
+  count_shard_owner() : shards() {}
+
+  count_shard*
+  shard(
+    int phase
+  ){
+    if (!shards[phase]) {
+      shards[phase] = new count_shard(phase);
+      count_shard_registry& registry = count_shard_registry::get();
+      std::lock_guard<std::mutex> guard(registry.lock);
+      registry.live.push_back(shards[phase]);
+    }
+    return shards[phase];
+  }
+
+  ~count_shard_owner(
+  ){
+    for (int p = 0; p < count_phase_capacity; ++p)
+      if (shards[p]) {
+        count_shard_registry::get().retire(shards[p]);
+        delete shards[p];
+      }
+  }
+};
+
+/* The shard that the calling thread counts into, once it has been
+   looked up for the current phase. */
+inline
+count_shard*&
+cached_count_shard(
+){
+  static thread_local count_shard* shard = nullptr;
+  return shard;
+}
+
+inline
+int&
+local_count_phase(
+){
+  static thread_local int phase = 0;
+  return phase;
+}
+
+inline
+count_shard*
+local_count_shard(
+){
+  count_shard*& shard = cached_count_shard();
+  if (!shard) {
+    static thread_local count_shard_owner owner;
+    shard = owner.shard(local_count_phase());
+  }
+  return shard;
+}
+
+/* Makes the calling thread count into the shards of phase from now on,
+   and returns the phase it counted in before. */
+inline
+int
+set_count_phase(
+  int phase
+){
+  int& current = local_count_phase();
+  int previous = current;
+  if (phase != previous) {
+    assert(phase >= 0 && phase < count_phase_capacity);
+    current = phase;
+    cached_count_shard() = nullptr;
+  }
+  return previous;
+}
+
+class sharded_count {
+protected:
+  size_t slot;
+
+  std::atomic<ssize_t>&
+  local(
+  ) const {
+    return local_count_shard()->values[slot];
+  }
+
+  void
+  add(
+    ssize_t n
+  ){
+    std::atomic<ssize_t>& v = local();
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  explicit
+  sharded_count(
+    bool is_maximum
+  ) : slot(count_shard_registry::get().allocate(is_maximum)) {}
+
+public:
+  sharded_count() : slot(count_shard_registry::get().allocate(false)) {}
+
+  sharded_count(const sharded_count&) = delete;
+
+  sharded_count&
+  operator++(
+  ){
+    add(1);
+    return *this;
+  }
+
+  void
+  operator++(
+    int
+  ){
+    add(1);
+  }
+
+  sharded_count&
+  operator+=(
+    ssize_t n
+  ){
+    add(n);
+    return *this;
+  }
+
+  sharded_count&
+  operator-=(
+    ssize_t n
+  ){
+    add(-n);
+    return *this;
+  }
+
+  /* Sets the combined count to n. */
+  sharded_count&
+  operator=(
+    ssize_t n
+  ){
+    count_shard_registry::get().clear(slot);
+    local().store(n, std::memory_order_relaxed);
+    return *this;
+  }
+
+  operator ssize_t(
+  ) const {
+    return count_shard_registry::get().combine(slot);
+  }
+
+  /* The combined count of the shards of phase. */
+  ssize_t
+  in_phase(
+    int phase
+  ) const {
+    return count_shard_registry::get().combine(slot, phase);
+  }
+};
+
+class sharded_max : public sharded_count {
+public:
+  sharded_max() : sharded_count(true) {}
+
+  using sharded_count::operator=;
+
+  /* Raises the calling thread's maximum to n. */
+  void
+  raise(
+    ssize_t n
+  ){
+    std::atomic<ssize_t>& v = local();
+    if (v.load(std::memory_order_relaxed) < n)
+      v.store(n, std::memory_order_relaxed);
+  }
+};
@@ -0,0 +1,220 @@
+/*
+
+The vectorized introsort of simdsort.h.  This file has no include
+guard: simdsort.h includes it once for each instruction set, inside a
+namespace that defines vec<T> and under the matching target pragma.
+
+Partitions of at most 2 * vec<T>::lanes elements are sorted by a
+bitonic sorting network held in two registers.  Larger partitions are
+split about a median-of-3 pivot by a vectorized partition that keeps
+the first and last register of the range aside, so that every
+register loaded afterwards has room to be compressed to both ends.
+When nothing is less than the pivot, the elements equal to it are
+gathered in one further pass and take no further part in the sort, so
+that ranges with few distinct values do not degrade to heapsort.
+
+*/
+
+/* Permutations and blend masks of the bitonic network for one register,
+   built once per value type. */
+template <typename T>
+struct network {
+  typedef vec<T> V;
+  typedef typename V::reg reg;
+
+  enum {
+    lanes = V::lanes,
+    log_lanes = lanes == 16 ? 4 : lanes == 8 ? 3 : 2,
+    sort_steps = log_lanes * (log_lanes + 1) / 2
+  };
+
+  typename V::index sort_index[sort_steps];
+  typename V::blend_mask sort_mask[sort_steps];
+  typename V::index merge_index[log_lanes];
+  typename V::blend_mask merge_mask[log_lanes];
+  typename V::index reverse;
+
+  network() {
+    int partner[lanes], take_max[lanes];
+    int step = 0;
+    for (int k = 2; k <= lanes; k *= 2)
+      for (int j = k / 2; j > 0; j /= 2, ++step) {
+        for (int i = 0; i < lanes; ++i) {
+          partner[i] = i ^ j;
+          take_max[i] = ((i & j) == 0) != ((i & k) == 0);
+        }
+        sort_index[step] = V::make_index(partner);
+        sort_mask[step] = V::make_mask(take_max);
+      }
+    step = 0;
+    for (int j = lanes / 2; j > 0; j /= 2, ++step) {
+      for (int i = 0; i < lanes; ++i) {
+        partner[i] = i ^ j;
+        take_max[i] = (i & j) != 0;
+      }
+      merge_index[step] = V::make_index(partner);
+      merge_mask[step] = V::make_mask(take_max);
+    }
+    for (int i = 0; i < lanes; ++i)
+      partner[i] = lanes - 1 - i;
+    reverse = V::make_index(partner);
+  }
+
+  static const network& get() {
+    static const network net;
+    return net;
+  }
+
+  reg
+  sort(
+    reg v
+  ) const {
+    for (int s = 0; s < sort_steps; ++s) {
+      reg other = V::permute(v, sort_index[s]);
+      v = V::blend(V::min(v, other), V::max(v, other), sort_mask[s]);
+    }
+    return v;
+  }
+
+  /* Sorts a bitonic register. */
+  reg
+  merge(
+    reg v
+  ) const {
+    for (int s = 0; s < log_lanes; ++s) {
+      reg other = V::permute(v, merge_index[s]);
+      v = V::blend(V::min(v, other), V::max(v, other), merge_mask[s]);
+    }
+    return v;
+  }
+};
+
+template <typename T>
+void
+small_sort(
+  T* first,
+  T* last
+){
+  typedef vec<T> V;
+  typedef typename V::reg reg;
+  const network<T>& net = network<T>::get();
+  const T pad = std::numeric_limits<T>::has_infinity
+                  ? std::numeric_limits<T>::infinity()
+                  : std::numeric_limits<T>::max();
+
+  T buffer[2 * V::lanes];
+  std::fill(buffer, buffer + 2 * V::lanes, pad);
+  std::copy(first, last, buffer);
+  if (last - first <= V::lanes) {
+    V::store(buffer, net.sort(V::load(buffer)));
+  } else {
+    reg low = net.sort(V::load(buffer));
+    reg high = V::permute(net.sort(V::load(buffer + V::lanes)), net.reverse);
+    V::store(buffer, net.merge(V::min(low, high)));
+    V::store(buffer + V::lanes, net.merge(V::max(low, high)));
+  }
+  std::copy(buffer, buffer + (last - first), first);
+}
+
+/* Moves the elements of [first, last) that are less than pivot, or not
+   greater than it if or_equal, to the front and returns the end of
+   them. */
+template <
+  bool or_equal,
+  typename T>
+T*
+partition(
+  T* first,
+  T* last,
+  T pivot
+){
+  typedef vec<T> V;
+  typedef typename V::reg reg;
+  const int lanes = V::lanes;
+  const unsigned all = (1u << lanes) - 1;
+
+  if (last - first < 2 * lanes) {
+    for (T* i = first; i != last; ++i)
+      if (or_equal ? !(pivot < *i) : *i < pivot)
+        std::iter_swap(first++, i);
+    return first;
+  }
+
+  reg p = V::set1(pivot);
+  T* write_first = first;
+  T* write_last = last;
+  auto put = [&](reg v) {
+    unsigned m = or_equal ? V::less_equal(v, p) : V::less(v, p);
+    int k = __builtin_popcount(m);
+    V::compress_store(write_first, m, v);
+    write_first += k;
+    write_last -= lanes - k;
+    V::compress_store(write_last, ~m & all, v);
+  };
+
+  reg saved_first = V::load(first);
+  reg saved_last = V::load(last - lanes);
+  T* read_first = first + lanes;
+  T* read_last = last - lanes;
+
+  while (read_last - read_first >= lanes) {
+    reg v;
+    if (read_first - write_first <= write_last - read_last) {
+      v = V::load(read_first);
+      read_first += lanes;
+    } else {
+      read_last -= lanes;
+      v = V::load(read_last);
+    }
+    put(v);
+  }
+
+  T rest[lanes];
+  T* rest_last = std::copy(read_first, read_last, rest);
+  for (T* i = rest; i != rest_last; ++i)
+    if (or_equal ? !(pivot < *i) : *i < pivot)
+      *write_first++ = *i;
+    else
+      *--write_last = *i;
+  put(saved_first);
+  put(saved_last);
+  return write_first;
+}
+
+template <typename T>
+void
+introsort_loop(
+  T* first,
+  T* last,
+  long depth_limit
+){
+  while (last - first > 2 * vec<T>::lanes) {
+    if (depth_limit == 0) {
+      bottom_up_heapsort(first, last, __gnu_cxx::__ops::__iter_less_iter());
+      return;
+    }
+    --depth_limit;
+    T* mid = first + (last - first) / 2;
+    std::__move_median_to_first(first, first + 1, mid, last - 1,
+                                __gnu_cxx::__ops::__iter_less_iter());
+    T pivot = *first;
+    T* cut = partition<false>(first + 1, last, pivot);
+    if (cut == first + 1) {
+      first = partition<true>(first + 1, last, pivot);
+      continue;
+    }
+    introsort_loop(cut, last, depth_limit);
+    last = cut;
+  }
+  small_sort(first, last);
+}
+
+template <typename T>
+void
+introsort(
+  T* first,
+  T* last
+){
+  if (last - first > 1)
+    introsort_loop(first, last, std::__lg(last - first) * 2);
+}
@@ -0,0 +1,448 @@
+/*
+
+Defines simd_introsort, a version of introsort for contiguous ranges of
+int, float and double that partitions and sorts small partitions with
+AVX2 or AVX-512 instructions.  The instruction set is chosen at run
+time from what the processor supports; simd_introsort returns false,
+leaving the range untouched, when the iterator or value type does not
+qualify or the processor has neither instruction set, and the caller
+should then use the scalar introsort.  On processors other than x86
+the vectorized sorts are not compiled at all, and simd_introsort
+always returns false.
+
+The algorithm itself is in simdkernel.h, which is compiled once for
+each instruction set, inside namespaces avx2_sort and avx512_sort.
+Each namespace first defines vec<T>, the operations on one vector
+register of T that the kernel uses.  Float ranges must not contain
+NaNs.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "heapsort.h"
+
+/* Value types with a vectorized sort. */
+template <typename T>
+struct simd_sortable_value {
+  static const bool value = false;
+};
+
+template <> struct simd_sortable_value<int> { static const bool value = true; };
+template <> struct simd_sortable_value<float> { static const bool value = true; };
+template <> struct simd_sortable_value<double> { static const bool value = true; };
+
+/* Iterator types that denote contiguous storage, with the conversion
+   to a pointer. */
+template <typename RandomAccessIterator>
+struct simd_sort_traits {
+  static const bool enabled = false;
+};
+
+template <typename T>
+struct simd_sort_traits<T*> {
+  typedef T value_type;
+  static const bool enabled = simd_sortable_value<T>::value;
+  static T* pointer(T* i) { return i; }
+};
+
+template <typename T>
+struct simd_sort_traits<__gnu_cxx::__normal_iterator<T*, std::vector<T> > > {
+  typedef T value_type;
+  static const bool enabled = simd_sortable_value<T>::value;
+  static T* pointer(__gnu_cxx::__normal_iterator<T*, std::vector<T> > i) {
+    return i.base();
+  }
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+namespace avx2_sort {
+
+/* Index and store-mask tables for compressing the 32-bit lanes of a
+   256-bit register selected by an 8-bit mask to the low lanes, or,
+   with pairs of 32-bit indices, the 64-bit lanes selected by a 4-bit
+   mask. */
+struct compress_tables {
+  int index8[256][8];
+  int prefix8[9][8];
+  int index4[16][8];
+  long long prefix4[5][4];
+
+  compress_tables() {
+    for (int m = 0; m < 256; ++m) {
+      int k = 0;
+      for (int i = 0; i < 8; ++i)
+        if (m & (1 << i))
+          index8[m][k++] = i;
+      for (; k < 8; ++k)
+        index8[m][k] = 0;
+    }
+    for (int n = 0; n <= 8; ++n)
+      for (int i = 0; i < 8; ++i)
+        prefix8[n][i] = i < n ? -1 : 0;
+    for (int m = 0; m < 16; ++m) {
+      int k = 0;
+      for (int i = 0; i < 4; ++i)
+        if (m & (1 << i)) {
+          index4[m][2 * k] = 2 * i;
+          index4[m][2 * k + 1] = 2 * i + 1;
+          ++k;
+        }
+      for (; k < 4; ++k)
+        index4[m][2 * k] = index4[m][2 * k + 1] = 0;
+    }
+    for (int n = 0; n <= 4; ++n)
+      for (int i = 0; i < 4; ++i)
+        prefix4[n][i] = i < n ? -1 : 0;
+  }
+
+  static const compress_tables& get() {
+    static const compress_tables tables;
+    return tables;
+  }
+};
+
+inline __m256i load_lanes(const int* lanes) {
+  return _mm256_loadu_si256((const __m256i*)lanes);
+}
+
+template <typename T>
+struct vec;
+
+template <>
+struct vec<int> {
+  typedef int value_type;
+  typedef __m256i reg;
+  typedef __m256i index;
+  typedef __m256i blend_mask;
+  enum { lanes = 8 };
+
+  static reg load(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+  static void store(int* p, reg v) { _mm256_storeu_si256((__m256i*)p, v); }
+  static reg set1(int x) { return _mm256_set1_epi32(x); }
+  static reg min(reg a, reg b) { return _mm256_min_epi32(a, b); }
+  static reg max(reg a, reg b) { return _mm256_max_epi32(a, b); }
+
+  static index make_index(const int* lane) { return load_lanes(lane); }
+  static reg permute(reg v, index i) { return _mm256_permutevar8x32_epi32(v, i); }
+
+  static blend_mask make_mask(const int* take_max) {
+    int m[8];
+    for (int i = 0; i < 8; ++i)
+      m[i] = take_max[i] ? -1 : 0;
+    return load_lanes(m);
+  }
+  static reg blend(reg low, reg high, blend_mask m) {
+    return _mm256_blendv_epi8(low, high, m);
+  }
+
+  static unsigned less(reg v, reg p) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(p, v)));
+  }
+  static unsigned less_equal(reg v, reg p) {
+    return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, p))) & 0xff;
+  }
+
+  static void compress_store(int* p, unsigned m, reg v) {
+    const compress_tables& t = compress_tables::get();
+    _mm256_maskstore_epi32(p, load_lanes(t.prefix8[__builtin_popcount(m)]),
+                           _mm256_permutevar8x32_epi32(v, load_lanes(t.index8[m])));
+  }
+};
+
+template <>
+struct vec<float> {
+  typedef float value_type;
+  typedef __m256 reg;
+  typedef __m256i index;
+  typedef __m256 blend_mask;
+  enum { lanes = 8 };
+
+  static reg load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, reg v) { _mm256_storeu_ps(p, v); }
+  static reg set1(float x) { return _mm256_set1_ps(x); }
+  static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+  static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+
+  static index make_index(const int* lane) { return load_lanes(lane); }
+  static reg permute(reg v, index i) { return _mm256_permutevar8x32_ps(v, i); }
+
+  static blend_mask make_mask(const int* take_max) {
+    return _mm256_castsi256_ps(vec<int>::make_mask(take_max));
+  }
+  static reg blend(reg low, reg high, blend_mask m) {
+    return _mm256_blendv_ps(low, high, m);
+  }
+
+  static unsigned less(reg v, reg p) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(v, p, _CMP_LT_OQ));
+  }
+  static unsigned less_equal(reg v, reg p) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(v, p, _CMP_LE_OQ));
+  }
+
+  static void compress_store(float* p, unsigned m, reg v) {
+    const compress_tables& t = compress_tables::get();
+    _mm256_maskstore_ps(p, load_lanes(t.prefix8[__builtin_popcount(m)]),
+                        _mm256_permutevar8x32_ps(v, load_lanes(t.index8[m])));
+  }
+};
+
+template <>
+struct vec<double> {
+  typedef double value_type;
+  typedef __m256d reg;
+  typedef __m256i index;
+  typedef __m256d blend_mask;
+  enum { lanes = 4 };
+
+  static reg load(const double* p) { return _mm256_loadu_pd(p); }
+  static void store(double* p, reg v) { _mm256_storeu_pd(p, v); }
+  static reg set1(double x) { return _mm256_set1_pd(x); }
+  static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+  static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+
+  static index make_index(const int* lane) {
+    int pairs[8];
+    for (int i = 0; i < 4; ++i) {
+      pairs[2 * i] = 2 * lane[i];
+      pairs[2 * i + 1] = 2 * lane[i] + 1;
+    }
+    return load_lanes(pairs);
+  }
+  static reg permute(reg v, index i) {
+    return _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(v), i));
+  }
+
+  static blend_mask make_mask(const int* take_max) {
+    int pairs[8];
+    for (int i = 0; i < 4; ++i)
+      pairs[2 * i] = pairs[2 * i + 1] = take_max[i];
+    return _mm256_castsi256_pd(vec<int>::make_mask(pairs));
+  }
+  static reg blend(reg low, reg high, blend_mask m) {
+    return _mm256_blendv_pd(low, high, m);
+  }
+
+  static unsigned less(reg v, reg p) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(v, p, _CMP_LT_OQ));
+  }
+  static unsigned less_equal(reg v, reg p) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(v, p, _CMP_LE_OQ));
+  }
+
+  static void compress_store(double* p, unsigned m, reg v) {
+    const compress_tables& t = compress_tables::get();
+    _mm256_maskstore_pd(p, _mm256_loadu_si256((const __m256i*)t.prefix4[__builtin_popcount(m)]),
+                        permute(v, load_lanes(t.index4[m])));
+  }
+};
+
+#include "simdkernel.h"
+
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+
+namespace avx512_sort {
+
+template <typename T>
+struct vec;
+
+template <>
+struct vec<int> {
+  typedef int value_type;
+  typedef __m512i reg;
+  typedef __m512i index;
+  typedef __mmask16 blend_mask;
+  enum { lanes = 16 };
+
+  static reg load(const int* p) { return _mm512_loadu_si512(p); }
+  static void store(int* p, reg v) { _mm512_storeu_si512(p, v); }
+  static reg set1(int x) { return _mm512_set1_epi32(x); }
+  static reg min(reg a, reg b) { return _mm512_min_epi32(a, b); }
+  static reg max(reg a, reg b) { return _mm512_max_epi32(a, b); }
+
+  static index make_index(const int* lane) { return _mm512_loadu_si512(lane); }
+  static reg permute(reg v, index i) { return _mm512_permutexvar_epi32(i, v); }
+
+  static blend_mask make_mask(const int* take_max) {
+    unsigned m = 0;
+    for (int i = 0; i < 16; ++i)
+      m |= unsigned(take_max[i] != 0) << i;
+    return blend_mask(m);
+  }
+  static reg blend(reg low, reg high, blend_mask m) {
+    return _mm512_mask_blend_epi32(m, low, high);
+  }
+
+  static unsigned less(reg v, reg p) {
+    return _mm512_cmp_epi32_mask(v, p, _MM_CMPINT_LT);
+  }
+  static unsigned less_equal(reg v, reg p) {
+    return _mm512_cmp_epi32_mask(v, p, _MM_CMPINT_LE);
+  }
+
+  static void compress_store(int* p, unsigned m, reg v) {
+    _mm512_mask_compressstoreu_epi32(p, __mmask16(m), v);
+  }
+};
+
+template <>
+struct vec<float> {
+  typedef float value_type;
+  typedef __m512 reg;
+  typedef __m512i index;
+  typedef __mmask16 blend_mask;
+  enum { lanes = 16 };
+
+  static reg load(const float* p) { return _mm512_loadu_ps(p); }
+  static void store(float* p, reg v) { _mm512_storeu_ps(p, v); }
+  static reg set1(float x) { return _mm512_set1_ps(x); }
+  static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+  static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+
+  static index make_index(const int* lane) { return _mm512_loadu_si512(lane); }
+  static reg permute(reg v, index i) { return _mm512_permutexvar_ps(i, v); }
+
+  static blend_mask make_mask(const int* take_max) {
+    return vec<int>::make_mask(take_max);
+  }
+  static reg blend(reg low, reg high, blend_mask m) {
+    return _mm512_mask_blend_ps(m, low, high);
+  }
+
+  static unsigned less(reg v, reg p) {
+    return _mm512_cmp_ps_mask(v, p, _CMP_LT_OQ);
+  }
+  static unsigned less_equal(reg v, reg p) {
+    return _mm512_cmp_ps_mask(v, p, _CMP_LE_OQ);
+  }
+
+  static void compress_store(float* p, unsigned m, reg v) {
+    _mm512_mask_compressstoreu_ps(p, __mmask16(m), v);
+  }
+};
+
+template <>
+struct vec<double> {
+  typedef double value_type;
+  typedef __m512d reg;
+  typedef __m512i index;
+  typedef __mmask8 blend_mask;
+  enum { lanes = 8 };
+
+  static reg load(const double* p) { return _mm512_loadu_pd(p); }
+  static void store(double* p, reg v) { _mm512_storeu_pd(p, v); }
+  static reg set1(double x) { return _mm512_set1_pd(x); }
+  static reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+  static reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+
+  static index make_index(const int* lane) {
+    long long wide[8];
+    for (int i = 0; i < 8; ++i)
+      wide[i] = lane[i];
+    return _mm512_loadu_si512(wide);
+  }
+  static reg permute(reg v, index i) { return _mm512_permutexvar_pd(i, v); }
+
+  static blend_mask make_mask(const int* take_max) {
+    unsigned m = 0;
+    for (int i = 0; i < 8; ++i)
+      m |= unsigned(take_max[i] != 0) << i;
+    return blend_mask(m);
+  }
+  static reg blend(reg low, reg high, blend_mask m) {
+    return _mm512_mask_blend_pd(m, low, high);
+  }
+
+  static unsigned less(reg v, reg p) {
+    return _mm512_cmp_pd_mask(v, p, _CMP_LT_OQ);
+  }
+  static unsigned less_equal(reg v, reg p) {
+    return _mm512_cmp_pd_mask(v, p, _CMP_LE_OQ);
+  }
+
+  static void compress_store(double* p, unsigned m, reg v) {
+    _mm512_mask_compressstoreu_pd(p, __mmask8(m), v);
+  }
+};
+
+#include "simdkernel.h"
+
+}
+
+#pragma GCC pop_options
+
+#endif
+
+enum simd_level { simd_scalar, simd_avx2, simd_avx512 };
+
+inline
+simd_level
+simd_support(
+){
+#if defined(__x86_64__) || defined(__i386__)
+  static const simd_level level = []{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      return simd_avx512;
+    if (__builtin_cpu_supports("avx2"))
+      return simd_avx2;
+    return simd_scalar;
+  }();
+  return level;
+#else
+  return simd_scalar;
+#endif
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+bool
+simd_introsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+#if defined(__x86_64__) || defined(__i386__)
+  typedef simd_sort_traits<RandomAccessIterator> traits;
+  if constexpr (!traits::enabled) {
+    return false;
+  } else {
+    typename traits::value_type* p = traits::pointer(first);
+    typename traits::value_type* q = traits::pointer(last);
+    switch (simd_support()) {
+    case simd_avx512:
+      avx512_sort::introsort(p, q);
+      return true;
+    case simd_avx2:
+      avx2_sort::introsort(p, q);
+      return true;
+    default:
+      return false;
+    }
+  }
+#else
+  (void)first;
+  (void)last;
+  return false;
+#endif
+}
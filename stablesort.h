@@ -0,0 +1,217 @@
+/*
+
+Defines stable_merge_sort, an adaptive natural merge sort after Peters'
+Timsort.  It scans [first, last) for runs, ascending or strictly
+descending (which it reverses, keeping equal elements in order),
+extends every run shorter than the insertion sort threshold of
+introsort_traits to that length by insertion sort, and merges the runs
+with the stable merge_adaptive of incsort.h, keeping a stack of runs
+whose lengths grow at least like the Fibonacci numbers from the top,
+so that merges stay balanced and the stack never holds more than about
+1.44 log2 N runs.  Sorted, reversed and concatenated sorted inputs are
+sorted in close to linear time, and the worst case is O(N log N).
+
+Merges use a scratch buffer of the caller's choosing:
+
+  - any buffer of buffer_size elements; with fewer than N/2 the merges
+    fall back on rotations where the shorter run does not fit, and with
+    none they are done entirely in place;
+  - a scratch_arena, which keeps its buffer between sorts and grows it
+    only when a longer sequence comes along, so that repeated sorts do
+    not allocate;
+  - by default, the scratch_arena of the calling thread for the value
+    type.
+
+Like introsort, it works with the counting iterators of itercount.h,
+whose operations it can be measured by next to introsort's; the scratch
+buffer is an array of the value type, so its elements are counted too,
+except when a scratch_arena grows.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "incsort.h"
+#include "intsort.h"
+
+/* Scratch memory for stable_merge_sort that is kept between sorts. */
+template <
+  typename T>
+class scratch_arena {
+protected:
+  std::vector<T> storage;
+
+public:
+  /* Returns a buffer of at least n elements. */
+  T*
+  reserve(
+    size_t n
+  ){
+    if (storage.size() < n)
+      std::vector<T>(std::max(n, 2 * storage.size())).swap(storage);
+    return storage.data();
+  }
+
+  size_t
+  capacity(
+  ) const {
+    return storage.size();
+  }
+
+  void
+  release(
+  ){
+    std::vector<T>().swap(storage);
+  }
+};
+
+/* The scratch_arena of the calling thread for values of type T. */
+template <
+  typename T>
+scratch_arena<T>&
+thread_scratch_arena(
+){
+  static thread_local scratch_arena<T> arena;
+  return arena;
+}
+
+/* Returns the end of the run that starts at first, after reversing it
+   if it is strictly descending. */
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+RandomAccessIterator
+natural_run(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  RandomAccessIterator next = first;
+  if (++next == last)
+    return last;
+  RandomAccessIterator current = next;
+  if (comp(next, first)) {
+    while (++next != last && comp(next, current))
+      ++current;
+    std::reverse(first, next);
+  } else {
+    while (++next != last && !comp(next, current))
+      ++current;
+  }
+  return next;
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare,
+  typename Pointer,
+  typename Distance>
+void
+stable_merge_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  Pointer buffer,
+  Distance buffer_size
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Difference;
+  const Difference min_run = iterator_introsort_traits<RandomAccessIterator>::threshold;
+
+  enum { stack_size = 16 * sizeof(size_t) };
+  RandomAccessIterator runs[stack_size + 1];
+  int count = 0;
+
+  /* The length of run i; run count - 1 ends at end. */
+  RandomAccessIterator end = first;
+  auto length = [&runs, &count, &end](int i) {
+    return (i + 1 < count ? runs[i + 1] : end) - runs[i];
+  };
+  auto merge_at = [&](int i) {
+    RandomAccessIterator merged_last = i + 2 < count ? runs[i + 2] : end;
+    merge_adaptive(runs[i], runs[i + 1], merged_last, buffer,
+                   Difference(buffer_size), comp);
+    for (int j = i + 1; j + 1 < count; ++j)
+      runs[j] = runs[j + 1];
+    --count;
+  };
+
+  while (end != last) {
+    RandomAccessIterator run_last = natural_run(end, last, comp);
+    if (run_last - end < min_run) {
+      run_last = last - end < min_run ? last : end + min_run;
+      std::__insertion_sort(end, run_last, comp);
+    }
+    assert(count < stack_size);
+    runs[count] = end;
+    ++count;
+    end = run_last;
+
+    while (count > 1) {
+      int n = count - 2;
+      if ((n > 0 && !(length(n) + length(n + 1) < length(n - 1)))
+          || (n > 1 && !(length(n - 1) + length(n) < length(n - 2)))) {
+        if (length(n - 1) < length(n + 1))
+          --n;
+      } else if (length(n + 1) < length(n)) {
+        break;
+      }
+      merge_at(n);
+    }
+  }
+  while (count > 1) {
+    int n = count - 2;
+    if (n > 0 && length(n - 1) < length(n + 1))
+      --n;
+    merge_at(n);
+  }
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+stable_merge_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp,
+  scratch_arena<typename std::iterator_traits<RandomAccessIterator>::value_type>& arena
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type Distance;
+  Distance n = last - first;
+  if (n < Distance(2))
+    return;
+  size_t half = (size_t(n) + 1) / 2;
+  stable_merge_sort(first, last, comp, arena.reserve(half), Distance(half));
+}
+
+template <
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+stable_merge_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  stable_merge_sort(first, last, comp, thread_scratch_arena<T>());
+}
+
+template <
+  typename RandomAccessIterator>
+inline
+void
+stable_merge_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  stable_merge_sort(first, last, __gnu_cxx::__ops::__iter_less_iter());
+}
@@ -0,0 +1,170 @@
+/*
+
+Defines class task_pool, a fixed set of worker threads that execute
+tasks of type task_pool::task.  Every worker owns a double-ended
+queue: it pushes and pops its own tasks at the back, and when that
+queue is empty it steals from the front of another worker's queue, so
+the large, old tasks near the root of a divide-and-conquer computation
+are the ones that migrate between threads.  A pool created for
+``threads'' threads starts threads-1 workers; the thread that calls
+wait() is expected to make up the last one, and executes pending tasks
+instead of blocking until the tasks it is waiting for are finished.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class task_pool {
+public:
+  typedef std::function<void()> task;
+
+protected:
+  struct worker_queue {
+    std::mutex lock;
+    std::deque<task> tasks;
+  };
+
+  std::vector<std::unique_ptr<worker_queue> > queues;
+  std::vector<std::thread> workers;
+  std::mutex idle_lock;
+  std::condition_variable idle;
+  std::atomic<ssize_t> queued;
+  std::atomic<bool> stopping;
+
+  /* Queue owned by the calling thread: workers own queues 1..size()-1,
+     every other thread shares queue 0. */
+  struct worker_identity {
+    const task_pool* pool;
+    size_t index;
+  };
+
+  static
+  worker_identity&
+  identity(
+  ){
+    static thread_local worker_identity self = {nullptr, 0};
+    return self;
+  }
+
+  size_t
+  own_queue(
+  ) const {
+    return identity().pool == this ? identity().index : 0;
+  }
+
+  bool
+  pop(
+    size_t index,
+    bool back,
+    task& t
+  ){
+    worker_queue& q = *queues[index];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.tasks.empty())
+      return false;
+    if (back) {
+      t = std::move(q.tasks.back());
+      q.tasks.pop_back();
+    } else {
+      t = std::move(q.tasks.front());
+      q.tasks.pop_front();
+    }
+    --queued;
+    return true;
+  }
+
+  void
+  work(
+    size_t index
+  ){
+    identity().pool = this;
+    identity().index = index;
+    while (!stopping) {
+      if (!run_one()) {
+        std::unique_lock<std::mutex> guard(idle_lock);
+        idle.wait_for(guard, std::chrono::milliseconds(1),
+                      [this]{ return stopping || queued > 0; });
+      }
+    }
+  }
+
+public:
+  explicit
+  task_pool(
+    unsigned threads = std::thread::hardware_concurrency()
+  ) : queued(0), stopping(false) {
+    if (threads == 0)
+      threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+      queues.emplace_back(new worker_queue);
+    for (unsigned i = 1; i < threads; ++i)
+      workers.emplace_back(&task_pool::work, this, i);
+  }
+
+  task_pool(const task_pool&) = delete;
+  task_pool& operator=(const task_pool&) = delete;
+
+  ~task_pool(
+  ){
+    stopping = true;
+    idle.notify_all();
+    for (auto& w : workers)
+      w.join();
+  }
+
+  size_t
+  size(
+  ) const {
+    return queues.size();
+  }
+
+  void
+  submit(
+    task t
+  ){
+    worker_queue& q = *queues[own_queue()];
+    {
+      std::lock_guard<std::mutex> guard(q.lock);
+      q.tasks.push_back(std::move(t));
+    }
+    ++queued;
+    idle.notify_one();
+  }
+
+  /* Runs one pending task, preferring the newest task of the calling
+     thread's own queue and otherwise stealing the oldest task of some
+     other queue.  Returns false if there was nothing to run. */
+  bool
+  run_one(
+  ){
+    size_t self = own_queue();
+    task t;
+    bool found = pop(self, true, t);
+    for (size_t i = 1; !found && i < queues.size(); ++i)
+      found = pop((self + i) % queues.size(), false, t);
+    if (!found)
+      return false;
+    t();
+    return true;
+  }
+
+  /* Helps execute tasks until outstanding drops to zero. */
+  void
+  wait(
+    const std::atomic<ssize_t>& outstanding
+  ){
+    while (outstanding > 0)
+      if (!run_one())
+        std::this_thread::yield();
+  }
+};
@@ -1,7 +1,10 @@
 /*
 
 Defines class timer for measuring computing times. Implemented
-using the standard clock function from time.h.
+using the standard clock function from time.h.  Also defines class
+wall_timer, with the same interface, which measures elapsed real time
+using std::chrono::steady_clock; clock() adds up the processor time of
+every thread, so parallel algorithms must be timed with wall_timer.
 
 
 */
@@ -45,3 +48,23 @@ public:
     return ((double)(finish_time - start_time))/CLOCKS_PER_SEC;
   }
 };
+
+class wall_timer {
+protected:
+  std::chrono::steady_clock::time_point start_time, finish_time;
+public:
+  void
+  start(){
+    start_time = std::chrono::steady_clock::now();
+  }
+
+  void
+  stop(){
+    finish_time = std::chrono::steady_clock::now();
+  }
+
+  double
+  lap_time() const {
+    return std::chrono::duration<double>(finish_time - start_time).count();
+  }
+};
@@ -2,6 +2,30 @@
 Example program for measuring the computing time of algorithms.
 This program both measures times and counts operations; for
 a simpler example of only measuring times, see tsort1.cpp.
+
+Run with the argument ``speedup'' to compare the parallel introsort
+with the serial one instead, ``simd'' to compare the vectorized
+introsort with the scalar one, ``radix'' and ``wide_radix'' to
+compare radix sort with introsort on unsigned and 64-bit keys,
+``samplesort'' to compare the parallel samplesort with the parallel
+introsort, ``duplicates'' to compare three-way partitioning with
+introsort on inputs with few distinct keys,
+``patterns'' to compare the pattern-defeating introsort with introsort
+on presorted and other patterned inputs, ``iterative'' to compare
+the introsort that uses an explicit stack with the recursive one,
+``thresholds'' to time introsort with a range of insertion sort
+thresholds and depth limits, ``autotune'' to measure the tuning
+constants of tuning.h on this host and write them to
+introsort_config.h, ``selection'' to compare introselect and the
+partial sort built on it with nth_element and partial_sort,
+``projection'' to compare sorting by a computed key with a comparator
+and with projected_introsort, ``indirect'' to compare sorting records
+directly and through an array of indices, ``segments'' to time the
+segmented sort of many short segments, ``incremental'' to compare
+merging an appended batch with sorting again, ``multipivot'' to time
+the dual- and three-pivot introsorts against introsort, ``cache'' to
+report the misses of a modeled cache hierarchy for each algorithm, or
+``external'' to time the external merge sort of a binary file.
 */
 
 /*
@@ -17,12 +41,51 @@ a simpler example of only measuring times, see tsort1.cpp.
  *
  */
 
+#include <string>
 #include <vector>
 
 #include "counter.h"
 #include "experiment.h"
 
 
-int main(){
-  experiment<int, double, counter, vector >::run();
+int main(int argc, char* argv[]){
+  std::string mode = argc > 1 ? argv[1] : "";
+  if (mode == "speedup")
+    experiment<int, double, counter, vector >::speedup();
+  else if (mode == "simd")
+    experiment<int, double, counter, vector >::simd();
+  else if (mode == "radix")
+    experiment<unsigned, double, counter, vector >::radix();
+  else if (mode == "wide_radix")
+    experiment<unsigned long long, double, counter, vector >::radix();
+  else if (mode == "samplesort")
+    experiment<int, double, counter, vector >::parallel_samplesort();
+  else if (mode == "duplicates")
+    experiment<int, double, counter, vector >::duplicates();
+  else if (mode == "patterns")
+    experiment<int, double, counter, vector >::patterns();
+  else if (mode == "iterative")
+    experiment<int, double, counter, vector >::iterative();
+  else if (mode == "thresholds")
+    experiment<int, double, counter, vector >::thresholds();
+  else if (mode == "autotune")
+    experiment<int, double, counter, vector >::autotune();
+  else if (mode == "selection")
+    experiment<int, double, counter, vector >::selection();
+  else if (mode == "projection")
+    experiment<int, double, counter, vector >::projection();
+  else if (mode == "indirect")
+    experiment<int, double, counter, vector >::indirect();
+  else if (mode == "segments")
+    experiment<int, double, counter, vector >::segments();
+  else if (mode == "incremental")
+    experiment<int, double, counter, vector >::incremental();
+  else if (mode == "multipivot")
+    experiment<int, double, counter, vector >::multipivot();
+  else if (mode == "cache")
+    experiment<int, double, counter, vector >::cache();
+  else if (mode == "external")
+    experiment<int, double, counter, vector >::external();
+  else
+    experiment<int, double, counter, vector >::run();
 }
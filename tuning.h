@@ -0,0 +1,53 @@
+/*
+
+Defines the compile-time tuning constants of the sorting algorithms:
+
+  INTROSORT_THRESHOLD          the insertion sort threshold of
+                               introsort_traits for trivially copyable
+                               values of up to 64 bytes;
+  INTROSORT_LARGE_THRESHOLD    the same for larger ones;
+  INTROSORT_PIVOT              the pivot selector of the default
+                               introsort_loop;
+  INTROSORT_PARALLEL_GRAIN     the default grain of the parallel
+                               introsort;
+  INTROSORT_RADIX_CROSSOVER    the length from which introsort radix
+                               sorts types with keys of up to 32 bits;
+  INTROSORT_WIDE_RADIX_CROSSOVER
+                               the same for 64-bit keys.
+
+Each one can be defined on the command line.  Otherwise, if the file
+introsort_config.h exists next to this one, as written by
+``tsort3 autotune'' after measuring the candidates on the host, its
+definitions are used, and the defaults below fill in the rest.
+
+*/
+
+#pragma once
+
+#if __has_include("introsort_config.h")
+#include "introsort_config.h"
+#endif
+
+#ifndef INTROSORT_THRESHOLD
+#define INTROSORT_THRESHOLD 32
+#endif
+
+#ifndef INTROSORT_LARGE_THRESHOLD
+#define INTROSORT_LARGE_THRESHOLD 8
+#endif
+
+#ifndef INTROSORT_PIVOT
+#define INTROSORT_PIVOT median_of_3_pivot
+#endif
+
+#ifndef INTROSORT_PARALLEL_GRAIN
+#define INTROSORT_PARALLEL_GRAIN (1 << 14)
+#endif
+
+#ifndef INTROSORT_RADIX_CROSSOVER
+#define INTROSORT_RADIX_CROSSOVER (1 << 12)
+#endif
+
+#ifndef INTROSORT_WIDE_RADIX_CROSSOVER
+#define INTROSORT_WIDE_RADIX_CROSSOVER (1 << 12)
+#endif